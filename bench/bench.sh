@@ -0,0 +1,35 @@
+#!/bin/sh
+# scaling benchmark: generates doom levels and wolf maps from 10 to 1M
+# sectors/cells with bin/gen and renders a fixed camera path through each,
+# reporting load time, memory and frame times. navigation queries are timed on
+# the doom levels
+#
+# $ make bench
+# $ FRAMES=5000 SIZES="1000 1000000" GENFLAGS="-o 0.9" make bench
+# $ QUERIES=100000 make bench
+set -e
+
+FRAMES=${FRAMES:-1000}
+QUERIES=${QUERIES:-10000}
+SIZES=${SIZES:-"10 100 1000 10000 100000 1000000"}
+GENFLAGS=${GENFLAGS:-}
+OUT=bin/bench
+
+mkdir -p $OUT
+
+echo "# doom"
+for n in $SIZES; do
+    bin/gen doom -n "$n" $GENFLAGS > "$OUT/doom_$n.txt"
+    bin/doom --level "$OUT/doom_$n.txt" --bench "$FRAMES" | tail -n 1
+done
+
+echo "# wolf"
+for n in $SIZES; do
+    bin/gen wolf -n "$n" $GENFLAGS > "$OUT/wolf_$n.txt"
+    bin/wolf --map "$OUT/wolf_$n.txt" --bench "$FRAMES" | tail -n 1
+done
+
+echo "# nav"
+for n in $SIZES; do
+    bin/doom --level "$OUT/doom_$n.txt" --nav-bench "$QUERIES" | tail -n 1
+done
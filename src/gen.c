@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// procedural level generator for benchmarking/stress testing
+//
+// $ gen doom [options] > level.txt: sector level for main_doom.c, a grid of
+// convex (square) sectors in the load_sectors() format
+// $ gen wolf [options] > map.txt: grid map for main_wolf.c
+//
+// see usage() for options
+
+#define ASSERT(_e, ...) if (!(_e)) { fprintf(stderr, __VA_ARGS__); exit(1); }
+
+typedef float    f32;
+typedef double   f64;
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   i8;
+typedef int16_t  i16;
+typedef int32_t  i32;
+typedef int64_t  i64;
+typedef size_t   usize;
+
+#define min(_a, _b) ({ __typeof__(_a) __a = (_a), __b = (_b); __a < __b ? __a : __b; })
+#define max(_a, _b) ({ __typeof__(_a) __a = (_a), __b = (_b); __a > __b ? __a : __b; })
+
+static struct {
+    // number of sectors (doom) or open cells (wolf)
+    usize n;
+
+    // sector size in world units
+    int cell;
+
+    // chance that an extra (non-spanning tree) edge is a portal/open
+    f32 portals;
+
+    // chance that an opening continues the opening before it in the same
+    // row/column. high values give long straight sightlines, low values give
+    // dense rooms
+    f32 openness;
+
+    // floor/ceiling height variation
+    f32 height;
+
+    // chance that an opening between two cells is a door, wolf only
+    f32 doors;
+
+    u64 seed;
+} opts = {
+    .n = 1000,
+    .cell = 8,
+    .portals = 0.3f,
+    .openness = 0.5f,
+    .height = 0.4f,
+    .seed = 1,
+};
+
+// see: https://prng.di.unimi.it/splitmix64.c
+static u64 rand_u64() {
+    u64 z = (opts.seed += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// random float in [0, 1)
+static f32 rand_f32() {
+    return (rand_u64() >> 40) / (f32) (1 << 24);
+}
+
+static bool chance(f32 p) {
+    return rand_f32() < p;
+}
+
+// union-find over cells for spanning tree construction
+static u32 uf_find(u32 *parent, u32 x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+// grid of w * h cells where the first n cells (row-major) exist. each cell
+// has an open flag for its left (x - 1) and bottom (y - 1) edges. a random
+// spanning tree guarantees every cell is reachable, extra edges are opened
+// according to opts.portals/opts.openness
+struct grid {
+    usize w, h, n;
+    u8 *left, *down;
+};
+
+static bool grid_has(const struct grid *g, i64 x, i64 y) {
+    return x >= 0 && y >= 0
+        && (usize) x < g->w && (usize) y < g->h
+        && ((usize) y * g->w) + x < g->n;
+}
+
+static void grid_make(struct grid *g, usize n) {
+    g->n = n;
+    g->w = 1;
+    while (g->w * g->w < n) { g->w++; }
+    g->h = (n + g->w - 1) / g->w;
+
+    g->left = calloc(n, 1);
+    g->down = calloc(n, 1);
+    ASSERT(g->left && g->down, "out of memory\n");
+
+    // shuffled list of all interior edges, edge e = (cell << 1) | is_down
+    u64 *edges = malloc(2 * n * sizeof(u64));
+    u32 *parent = malloc(n * sizeof(u32));
+    ASSERT(edges && parent, "out of memory\n");
+
+    usize nedges = 0;
+    for (usize i = 0; i < n; i++) {
+        const usize x = i % g->w, y = i / g->w;
+        parent[i] = i;
+        if (grid_has(g, (i64) x - 1, y)) { edges[nedges++] = (i << 1) | 0; }
+        if (grid_has(g, x, (i64) y - 1)) { edges[nedges++] = (i << 1) | 1; }
+    }
+
+    for (usize i = nedges; i > 1; i--) {
+        const usize j = rand_u64() % i;
+        const u64 t = edges[i - 1];
+        edges[i - 1] = edges[j];
+        edges[j] = t;
+    }
+
+    // kruskal with random weights -> random spanning tree
+    for (usize i = 0; i < nedges; i++) {
+        const usize c = edges[i] >> 1;
+        const bool down = edges[i] & 1;
+        const usize o = down ? c - g->w : c - 1;
+
+        const u32 rc = uf_find(parent, c), ro = uf_find(parent, o);
+        if (rc == ro) { continue; }
+
+        parent[rc] = ro;
+        (down ? g->down : g->left)[c] = 1;
+    }
+
+    // extra openings, runs in row/column order so that an edge can continue
+    // the opening of the previous collinear edge
+    for (usize i = 0; i < n; i++) {
+        const usize x = i % g->w, y = i / g->w;
+
+        const f32 prun = max(opts.openness, opts.portals);
+
+        if (!g->left[i] && grid_has(g, (i64) x - 1, y)) {
+            const bool run = g->left[i - 1];
+            g->left[i] = chance(run ? prun : opts.portals);
+        }
+
+        if (!g->down[i] && grid_has(g, x, (i64) y - 1)) {
+            const bool run = y > 1 && g->down[i - g->w];
+            g->down[i] = chance(run ? prun : opts.portals);
+        }
+    }
+
+    free(edges);
+    free(parent);
+}
+
+// sectors are cell-sized squares, walls in clockwise order (interior on the
+// right) as load_sectors()/point_in_sector() expect. one sector per cell,
+// sector id = cell index + 1
+static void gen_doom() {
+    struct grid g;
+    grid_make(&g, opts.n);
+
+    printf("# generated: n=%zu cell=%d portals=%.2f openness=%.2f height=%.2f\n",
+        opts.n, opts.cell, opts.portals, opts.openness, opts.height);
+
+    printf("[SECTOR]\n");
+    for (usize i = 0; i < g.n; i++) {
+        // quantize to 0.1 so that output is stable and readable
+        const f32
+            zfloor = ((int) (rand_f32() * opts.height * 10.0f)) / 10.0f,
+            zceil =
+                zfloor + 3.0f
+                    + ((int) (rand_f32() * opts.height * 10.0f)) / 10.0f;
+        printf("%zu %zu 4 %.1f %.1f\n", i + 1, i * 4, zfloor, zceil);
+    }
+
+    printf("\n[WALL]\n");
+    for (usize i = 0; i < g.n; i++) {
+        const usize x = i % g.w, y = i / g.w;
+        const long
+            x0 = x * opts.cell, x1 = (x + 1) * opts.cell,
+            y0 = y * opts.cell, y1 = (y + 1) * opts.cell;
+
+        // portal ids of neighbors through each side, 0 if solid
+        const usize
+            down = g.down[i] ? (i - g.w) + 1 : 0,
+            left = g.left[i] ? (i - 1) + 1 : 0,
+            up = grid_has(&g, x, y + 1) && g.down[i + g.w] ? (i + g.w) + 1 : 0,
+            right = grid_has(&g, x + 1, y) && g.left[i + 1] ? (i + 1) + 1 : 0;
+
+        printf("%ld %ld %ld %ld %zu\n", x1, y0, x0, y0, down);
+        printf("%ld %ld %ld %ld %zu\n", x0, y0, x0, y1, left);
+        printf("%ld %ld %ld %ld %zu\n", x0, y1, x1, y1, up);
+        printf("%ld %ld %ld %ld %zu\n", x1, y1, x1, y0, right);
+    }
+
+    free(g.left);
+    free(g.down);
+}
+
+// each grid cell becomes a 2x2 block in the map: the cell itself is open,
+// its left/bottom neighbors in the map are open if the grid edge is, the
+// remaining corner is always a wall. map gets a solid border
+static void gen_wolf() {
+    struct grid g;
+    grid_make(&g, opts.n);
+
+    const usize w = (g.w * 2) + 1, h = (g.h * 2) + 1;
+    u8 *map = malloc(w * h);
+    ASSERT(map, "out of memory\n");
+
+    for (usize i = 0; i < w * h; i++) {
+        map[i] = 1 + (rand_u64() % 4);
+    }
+
+    for (usize i = 0; i < g.n; i++) {
+        const usize x = (i % g.w) * 2 + 1, y = (i / g.w) * 2 + 1;
+        map[(y * w) + x] = 0;
+        // doors are cell value 5
+        if (g.left[i]) { map[(y * w) + x - 1] = chance(opts.doors) ? 5 : 0; }
+        if (g.down[i]) { map[((y - 1) * w) + x] = chance(opts.doors) ? 5 : 0; }
+    }
+
+    printf("# generated: n=%zu portals=%.2f openness=%.2f doors=%.2f\n",
+        opts.n, opts.portals, opts.openness, opts.doors);
+    printf("%zu %zu\n", w, h);
+
+    char *line = malloc(w + 2);
+    ASSERT(line, "out of memory\n");
+
+    for (usize y = 0; y < h; y++) {
+        for (usize x = 0; x < w; x++) {
+            line[x] = '0' + map[(y * w) + x];
+        }
+        line[w] = '\n';
+        line[w + 1] = '\0';
+        fputs(line, stdout);
+    }
+
+    free(line);
+    free(map);
+    free(g.left);
+    free(g.down);
+}
+
+static void usage() {
+    fprintf(
+        stderr,
+        "usage: gen doom|wolf [options]\n"
+        "  -n N   number of sectors/cells (default %zu)\n"
+        "  -c N   sector size in world units, doom only (default %d)\n"
+        "  -p F   portal density in [0, 1] (default %.2f)\n"
+        "  -o F   openness in [0, 1], long sightlines vs. dense rooms "
+            "(default %.2f)\n"
+        "  -z F   height variation, doom only (default %.2f)\n"
+        "  -d F   chance that an opening is a door, wolf only (default %.2f)\n"
+        "  -s N   random seed (default %llu)\n",
+        opts.n, opts.cell, opts.portals, opts.openness, opts.height,
+        opts.doors, (unsigned long long) opts.seed);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) { usage(); }
+
+    for (int i = 2; i < argc; i++) {
+        if (argv[i][0] != '-' || !argv[i][1] || argv[i][2] || i + 1 >= argc) {
+            usage();
+        }
+
+        const char *v = argv[++i];
+        switch (argv[i - 1][1]) {
+        case 'n': opts.n = strtoull(v, NULL, 10); break;
+        case 'c': opts.cell = atoi(v); break;
+        case 'p': opts.portals = atof(v); break;
+        case 'o': opts.openness = atof(v); break;
+        case 'z': opts.height = atof(v); break;
+        case 'd': opts.doors = atof(v); break;
+        case 's': opts.seed = strtoull(v, NULL, 10); break;
+        default: usage();
+        }
+    }
+
+    ASSERT(opts.n > 0, "need at least one sector\n");
+    ASSERT(opts.cell > 0, "invalid cell size\n");
+
+    if (!strcmp(argv[1], "doom")) {
+        gen_doom();
+    } else if (!strcmp(argv[1], "wolf")) {
+        gen_wolf();
+    } else {
+        usage();
+    }
+
+    return 0;
+}
@@ -1,9 +1,20 @@
+#define _DEFAULT_SOURCE
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 #include <SDL.h>
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
 #define ASSERT(_e, ...) if (!(_e)) { fprintf(stderr, __VA_ARGS__); exit(1); }
 
 typedef float    f32;
@@ -37,8 +48,36 @@ typedef ssize_t  isize;
 #define ZNEAR 0.0001f
 #define ZFAR  128.0f
 
+// fog color and distance at which fog starts as a fraction of the view
+// distance (--fog)
+#define FOG_COLOR 0xFF404040
+#define FOG_START 0.25f
+
+// simulation runs at a fixed rate independent of the render rate, render
+// camera is interpolated between the last two ticks
+#define TICK_RATE 60
+#define TICK_DT (1.0f / TICK_RATE)
+
+// max ticks simulated per frame, time beyond this is dropped so simulation
+// cost stays bounded when rendering is slow
+#define TICK_MAX_PER_FRAME 8
+
+#define ROT_SPEED 3.0f
+#define MOVE_SPEED 3.0f
+
+// player collision radius and height
+#define PLAYER_RADIUS 0.25f
+#define PLAYER_HEIGHT 1.8f
+
+// max floor height difference which the player can step up
+#define STEP_HEIGHT 0.5f
+
+// slack when testing for contact with a wall face
+#define COLLIDE_EPS 0.0001f
+
 typedef struct v2_s { f32 x, y; } v2;
 typedef struct v2i_s { i32 x, y; } v2i;
+typedef struct v2s_s { i16 x, y; } v2s;
 
 #define v2_to_v2i(_v) ({ __typeof__(_v) __v = (_v); (v2i) { __v.x, __v.y }; })
 #define v2i_to_v2(_v) ({ __typeof__(_v) __v = (_v); (v2) { __v.x, __v.y }; })
@@ -49,6 +88,19 @@ typedef struct v2i_s { i32 x, y; } v2i;
 #define min(_a, _b) ({ __typeof__(_a) __a = (_a), __b = (_b); __a < __b ? __a : __b; })
 #define max(_a, _b) ({ __typeof__(_a) __a = (_a), __b = (_b); __a > __b ? __a : __b; })
 #define clamp(_x, _mi, _ma) (min(max(_x, _mi), _ma))
+// push zeroed element onto a dynamic array { T *arr; usize n, cap; },
+// returns pointer to the new element
+#define dynarr_push(_da) ({                                                    \
+        __typeof__(_da) __da = (_da);                                          \
+        if (__da->n == __da->cap) {                                            \
+            __da->cap = __da->cap ? (__da->cap * 2) : 16;                      \
+            __da->arr = realloc(__da->arr, __da->cap * sizeof(*__da->arr));    \
+            ASSERT(__da->arr, "out of memory");                                \
+        }                                                                      \
+        memset(&__da->arr[__da->n], 0, sizeof(*__da->arr));                    \
+        &__da->arr[__da->n++];                                                 \
+    })
+
 #define ifnan(_x, _alt) ({ __typeof__(_x) __x = (_x); isnan(__x) ? (_alt) : __x; })
 
 // -1 right, 0 on, 1 left
@@ -96,46 +148,402 @@ static inline u32 abgr_mul(u32 col, u32 a) {
     return 0xFF000000 | (br & 0xFF00FF) | (g & 0x00FF00);
 }
 
-struct wall {
+// blend from col0 to col1 by t in [0, 256]
+static inline u32 abgr_lerp(u32 col0, u32 col1, u32 t) {
+    const u32
+        br = (((col0 & 0xFF00FF) * (256 - t)) + ((col1 & 0xFF00FF) * t)) >> 8,
+        g  = (((col0 & 0x00FF00) * (256 - t)) + ((col1 & 0x00FF00) * t)) >> 8;
+
+    return 0xFF000000 | (br & 0xFF00FF) | (g & 0x00FF00);
+}
+
+// wall/sector as written in level files, only used while loading
+struct wall_def {
     v2i a, b;
     int portal;
 };
 
-// sector id for "no sector"
-#define SECTOR_NONE 0
-#define SECTOR_MAX 128
-
-struct sector {
+struct sector_def {
     int id;
     usize firstwall, nwalls;
     f32 zfloor, zceil;
 };
 
+// sector id for "no sector"
+#define SECTOR_NONE 0
+
+struct bbox { v2s min, max; };
+
+// uniform grid over the level bounds, each cell lists the sectors whose
+// bounding box overlaps it. used to find the sector containing a point
+struct sector_grid {
+    v2 min;
+    f32 size;
+    int w, h;
+
+    // sector count the grid was sized for
+    usize nsectors;
+
+    struct { int *arr; usize n, cap; } *cells;
+};
+
+// level data as structure-of-arrays. data used every frame is kept narrow:
+// coordinates are quantized to i16 and sector/wall indices to u32/u16, which
+// load_sectors() checks the level fits into. sector ids are only used for
+// ordering in level files and are not kept
+struct level {
+    usize nsectors, nwalls;
+
+    struct {
+        u32 *firstwall;
+        u16 *nwalls;
+        f32 *zfloor, *zceil;
+    } sectors;
+
+    struct {
+        v2s *a, *b;
+
+        // sector index, not narrowed to u16: generated levels go up to 1M
+        // sectors and a portal can lead to any of them
+        u32 *portal;
+    } walls;
+
+    // derived data, see level_derive() and level_grid()
+    u8 *wallshade;
+    struct bbox *bounds;
+    struct sector_grid grid;
+};
+
+// portal window queued for drawing
+struct queue_entry { int id, x0, x1; };
+
+struct camera {
+    v2 pos;
+    f32 angle, anglecos, anglesin;
+    int sector;
+};
+
+// render target, pixels are w * h ABGR with y = 0 at the bottom
+struct view {
+    u32 *pixels;
+    int w, h;
+};
+
+// per-thread render scratch, sized on demand to view width/level size
+struct render_scratch {
+    u16 *y_lo, *y_hi;
+    int w;
+
+    // portal queue and per-sector frame number of last draw, stamped instead
+    // of cleared so that cost does not scale with level size
+    struct { struct queue_entry *arr; usize n, cap; } queue;
+    u32 *sectdraw, frame;
+    usize nsectors;
+};
+
+// navigation query: path for an agent at from_pos in sector from to to_pos in
+// sector to. if points is set up to maxpoints waypoints are written to it
+struct nav_query {
+    int from, to;
+    v2 from_pos, to_pos;
+    v2 *points;
+    u32 maxpoints;
+
+    // only resolve the path through the next NAV_LOOKAHEAD clusters, enough
+    // to get the next waypoint at a cost independent of path length. agents
+    // query again as they move
+    bool lookahead;
+};
+
+// navigation result. waypoints are the midpoints of crossed portal walls
+// followed by to_pos, length is the length of that polyline from from_pos
+struct nav_path {
+    bool found;
+    f32 length;
+
+    // sectors on the path including the first and last one
+    u32 nsectors;
+
+    // first waypoint, where the agent should head next
+    v2 next;
+
+    // waypoints written to nav_query::points
+    u32 npoints;
+
+    // path ends at the entry of a later cluster instead of to, see
+    // nav_query::lookahead
+    bool partial;
+};
+
+// binary min-heap of search nodes
+struct nav_heap_entry { f32 key, g; u32 id; };
+struct nav_heap { struct nav_heap_entry *arr; usize n, cap; };
+
+// per-thread navigation scratch, sized on demand to level/cluster count.
+// search state is stamped instead of cleared like render_scratch::sectdraw
+struct nav_scratch {
+    usize nsectors, nclusters;
+
+    // per sector: stamp of last visit, best cost, previous sector and the
+    // portal wall (of the previous sector) the path enters through
+    u32 *seen, *parent, *via, stamp;
+    f32 *g;
+
+    // per cluster: corridor stamp of queries, distance in nav_build()
+    u32 *corridor, cstamp;
+    f32 *dist;
+
+    struct nav_heap heap;
+};
+
+// sectors per navigation cluster, grows with level size so that the cluster
+// count (and with it the next hop table) stays bounded
+#define NAV_CLUSTER_MIN 64
+#define NAV_CLUSTER_DIV 1024
+
+// more clusters than this disables the hierarchy, queries then search the
+// whole graph. keeps the next hop table <= 32MiB
+#define NAV_CLUSTERS_MAX 4096
+#define NAV_NONE 0xFFFF
+
+// clusters resolved by lookahead queries
+#define NAV_LOOKAHEAD 2
+
+// queries per pool job in nav_paths()
+#define NAV_BATCH 64
+
+// size of views rendered by bench --views
+#define BENCH_VIEW_WIDTH (SCREEN_WIDTH / 4)
+#define BENCH_VIEW_HEIGHT (SCREEN_HEIGHT / 4)
+
+// max worker threads for batched jobs (render_views(), nav_paths())
+#define POOL_THREADS_MAX 64
+
+// number of framebuffers queued for the capture writer thread
+#define CAPTURE_RING 8
+
+// max time to wait for events while idle (ms), bounds level reload latency
+#define IDLE_WAIT_MS 100
+
+// pipeline stages/latencies recorded per frame with --latency
+enum {
+    LATENCY_SIMULATE,
+    LATENCY_RENDER,
+    LATENCY_UPLOAD,
+    LATENCY_PRESENT,
+    LATENCY_SAMPLE_TO_PRESENT,
+    LATENCY_INPUT_TO_PRESENT,
+    LATENCY_COUNT
+};
+
+static const char *LATENCY_NAMES[LATENCY_COUNT] = {
+    [LATENCY_SIMULATE] = "simulate",
+    [LATENCY_RENDER] = "render",
+    [LATENCY_UPLOAD] = "upload",
+    [LATENCY_PRESENT] = "present",
+    [LATENCY_SAMPLE_TO_PRESENT] = "sample->present",
+    [LATENCY_INPUT_TO_PRESENT] = "input->present",
+};
+
+// frames of work times the just in time frame start is estimated from, and
+// safety margin left before the vsync deadline (seconds)
+#define LATENCY_WORK_FRAMES 32
+#define LATENCY_MARGIN 0.002
+
+// samples kept per latency stage for --latency, the report covers the most
+// recent ones (~68s at 60fps)
+#define LATENCY_SAMPLES 4096
+
 static struct {
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_Texture *texture, *debug;
-    u32 *pixels;
     bool quit;
 
-    struct { struct sector arr[32]; usize n; } sectors;
-    struct { struct wall arr[128]; usize n; } walls;
+    struct level level;
+    const char *level_path;
+
+    // incremented whenever the level changes
+    u64 level_version;
+
+    // level hot reload. level file is watched for changes, the new level is
+    // loaded and diffed against the current one on a worker thread and
+    // swapped in between frames once it is ready
+    struct {
+        pthread_t thread;
+        atomic_bool done;
+        bool running, pending;
+
+        // worker results
+        struct level level;
+        int result;
+        u8 *changed;
+        usize nchanged;
+        f64 time;
+
+#ifdef __linux__
+        int fd;
+        const char *name;
+#else
+        time_t mtime;
+        f64 last;
+#endif
+    } reload;
+
+    // main view (window framebuffer) and main thread render scratch
+    struct view view;
+    struct render_scratch scratch;
+
+    // worker threads for batched jobs. jobs of a batch are handed out one at
+    // a time through an atomic counter, the calling thread is thread 0 and
+    // takes jobs too
+    struct {
+        pthread_t threads[POOL_THREADS_MAX];
+        int n;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t start, done;
+        u64 batch;
+        int active;
+
+        void (*job)(usize i, int thread);
+        usize njobs;
+        atomic_size_t next;
+
+        // render scratch of worker threads
+        struct render_scratch scratch[POOL_THREADS_MAX];
+
+        // current render_views() batch
+        const struct camera *cameras;
+        struct view *views;
+    } pool;
+
+    // frame capture. rendered frames are copied into a ring of framebuffers
+    // and written out by a writer thread. when the ring is full frames are
+    // dropped, the render loop never waits on the writer. the stream has one
+    // frame per simulation tick (TICK_RATE fps) whatever the render rate:
+    // each rendered frame is written once per tick simulated before it, and
+    // dropped frames are filled in by repeating the last queued one
+    struct {
+        FILE *file;
+        const char *path;
+        bool y4m;
+
+        pthread_t thread;
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        bool stop;
+
+        // ring slots [tail, head) are queued, guarded by mutex. each slot is
+        // written 1 + repeat times
+        u32 *frames[CAPTURE_RING], repeat[CAPTURE_RING];
+        usize head, tail;
+
+        // writer conversion buffer, set if a write has failed, frames
+        // written including repeats
+        u8 *buf;
+        bool failed;
+        usize written;
+
+        // frames submitted, dropped with ring full, submitted with ring more
+        // than half full (backpressure), max ring occupancy
+        usize submitted, dropped, backlog, maxqueued;
+    } capture;
+
+    // input latency. --latency records per frame stage timings and input to
+    // present latency, --low-latency samples input as late as possible and
+    // renders the latest tick instead of interpolating, --jit additionally
+    // delays the start of each frame so it finishes just before vsync
+    struct {
+        bool report, low, jit;
+
+        // timestamps (time_s()) of the current frame. input is the earliest
+        // input event since the previous frame, 0 if there was none
+        f64 input, sample, simulate, render, upload, present;
 
-    u16 y_lo[SCREEN_WIDTH], y_hi[SCREEN_WIDTH];
+        // display refresh period, work time (sample -> upload) of recent
+        // frames for the just in time estimate
+        f64 period, work[LATENCY_WORK_FRAMES];
+        usize frames;
 
+        // ring of the last LATENCY_SAMPLES samples per stage, n is the total
+        // number recorded
+        struct { f64 arr[LATENCY_SAMPLES]; usize n; } samples[LATENCY_COUNT];
+    } latency;
+
+    // camera used for rendering, interpolated from player state
+    struct camera camera;
+
+    // player state as of the previous and current simulation tick
+    struct { struct camera prev, curr; } player;
+
+    // no vsync, render as fast as possible and report frame times
+    bool uncapped;
+
+    // view distance, nothing is rendered beyond it and geometry fades into
+    // FOG_COLOR towards it. 0 if disabled
+    f32 fog;
+
+    // sector graph navigation, see nav_build(). rebuilt on first query after
+    // the level changed
+    struct {
+        u64 level_version;
+        f64 build_time;
+
+        // per sector: center and cluster
+        v2 *center;
+        u32 *cluster;
+
+        // cluster centers and reverse cluster graph (for each cluster the
+        // clusters with a passable edge into it) as offsets into src
+        usize nclusters;
+        v2 *ccenter;
+        u32 *rfirst, *rsrc;
+
+        // next[(goal * nclusters) + c] is the cluster to move to from c to
+        // reach goal, NAV_NONE if unreachable. NULL if there are too many
+        // clusters for a table
+        u16 *next;
+
+        struct nav_scratch scratch[POOL_THREADS_MAX + 1];
+
+        // current nav_paths() batch
+        const struct nav_query *queries;
+        struct nav_path *paths;
+        usize nqueries;
+    } nav;
+
+    // frame reuse. a frame is only rendered if the camera or level changed
+    // since the last rendered one, otherwise the window keeps showing it and
+    // the main loop sleeps. off when uncapped/capturing. input is set if key
+    // events arrived since the last frame
     struct {
-        v2 pos;
-        f32 angle, anglecos, anglesin;
-        int sector;
-    } camera;
+        bool enabled, valid, input;
+        struct camera camera;
+        u64 level_version;
+    } reuse;
+
+    // window loop clock, see frame_advance(). time_s() of the last frame and
+    // real time not simulated yet. idle is set while the loop sleeps, idle
+    // time is not simulated
+    struct {
+        f64 last, accum;
+        bool idle;
+    } clock;
+
+    // walls considered for collision this tick and the sectors they were
+    // gathered from, see collision_walls()
+    struct { u32 *arr; usize n, cap; } collide;
+    struct { int *arr; usize n, cap; } collide_sectors;
 
     bool sleepy;
 } state;
 
-// convert angle in [-(HFOV / 2)..+(HFOV / 2)] to X coordinate
-static inline int screen_angle_to_x(f32 angle) {
+// convert angle in [-(HFOV / 2)..+(HFOV / 2)] to X coordinate on a view of
+// width w
+static inline int screen_angle_to_x(f32 angle, int w) {
     return
-        ((int) (SCREEN_WIDTH / 2))
+        ((int) (w / 2))
             * (1.0f - tan(((angle + (HFOV / 2.0)) / HFOV) * PI_2 - PI_4));
 }
 
@@ -145,24 +553,38 @@ static inline f32 normalize_angle(f32 a) {
 }
 
 // world space -> camera space (translate and rotate)
-static inline v2 world_pos_to_camera(v2 p) {
-    const v2 u = { p.x - state.camera.pos.x, p.y - state.camera.pos.y };
+static inline v2 world_pos_to_camera(const struct camera *c, v2 p) {
+    const v2 u = { p.x - c->pos.x, p.y - c->pos.y };
     return (v2) {
-        u.x * state.camera.anglesin - u.y * state.camera.anglecos,
-        u.x * state.camera.anglecos + u.y * state.camera.anglesin,
+        u.x * c->anglesin - u.y * c->anglecos,
+        u.x * c->anglecos + u.y * c->anglesin,
     };
 }
 
-static void present();
+static f64 time_s() {
+    return SDL_GetPerformanceCounter() / (f64) SDL_GetPerformanceFrequency();
+}
 
-// load sectors from file -> state
-static int load_sectors(const char *path) {
-    // sector 0 does not exist
-    state.sectors.n = 1;
+static void present();
 
+// load sectors from file -> level, which must be empty
+static int load_sectors(struct level *level, const char *path) {
     FILE *f = fopen(path, "r");
     if (!f) { return -1; }
 
+    // level arrays are grown while parsing, each line is parsed at full
+    // width and checked against the narrow types before it is stored
+    struct { u32 *arr; usize n, cap; } firstwall = { 0 }, portal = { 0 };
+    struct { u16 *arr; usize n, cap; } nwalls = { 0 };
+    struct { f32 *arr; usize n, cap; } zfloor = { 0 }, zceil = { 0 };
+    struct { v2s *arr; usize n, cap; } wa = { 0 }, wb = { 0 };
+
+    // sector 0 does not exist
+    dynarr_push(&firstwall);
+    dynarr_push(&nwalls);
+    dynarr_push(&zfloor);
+    dynarr_push(&zceil);
+
     int retval = 0;
     enum { SCAN_SECTOR, SCAN_WALL, SCAN_NONE } ss = SCAN_NONE;
 
@@ -187,32 +609,58 @@ static int load_sectors(const char *path) {
         } else {
             switch (ss) {
             case SCAN_WALL: {
-                struct wall *wall = &state.walls.arr[state.walls.n++];
+                struct wall_def wall;
                 if (sscanf(
                         p,
                         "%d %d %d %d %d",
-                        &wall->a.x,
-                        &wall->a.y,
-                        &wall->b.x,
-                        &wall->b.y,
-                        &wall->portal)
+                        &wall.a.x,
+                        &wall.a.y,
+                        &wall.b.x,
+                        &wall.b.y,
+                        &wall.portal)
                         != 5) {
                     retval = -4; goto done;
                 }
+
+                // coordinates must fit i16
+                if (wall.a.x != (i16) wall.a.x || wall.a.y != (i16) wall.a.y
+                    || wall.b.x != (i16) wall.b.x
+                    || wall.b.y != (i16) wall.b.y) {
+                    retval = -10; goto done;
+                }
+
+                if (wall.portal < 0) { retval = -8; goto done; }
+
+                *dynarr_push(&wa) = (v2s) { wall.a.x, wall.a.y };
+                *dynarr_push(&wb) = (v2s) { wall.b.x, wall.b.y };
+                *dynarr_push(&portal) = wall.portal;
             }; break;
             case SCAN_SECTOR: {
-                struct sector *sector = &state.sectors.arr[state.sectors.n++];
+                struct sector_def sector;
                 if (sscanf(
                         p,
                         "%d %zu %zu %f %f",
-                        &sector->id,
-                        &sector->firstwall,
-                        &sector->nwalls,
-                        &sector->zfloor,
-                        &sector->zceil)
+                        &sector.id,
+                        &sector.firstwall,
+                        &sector.nwalls,
+                        &sector.zfloor,
+                        &sector.zceil)
                         != 5) {
                     retval = -5; goto done;
                 }
+
+                if (sector.firstwall > UINT32_MAX
+                    || sector.nwalls > UINT16_MAX) {
+                    retval = -11; goto done;
+                }
+
+                // a sector needs an area, sector_center() divides by nwalls
+                if (sector.nwalls < 3) { retval = -13; goto done; }
+
+                *dynarr_push(&firstwall) = sector.firstwall;
+                *dynarr_push(&nwalls) = sector.nwalls;
+                *dynarr_push(&zfloor) = sector.zfloor;
+                *dynarr_push(&zceil) = sector.zceil;
             }; break;
             default: retval = -6; goto done;
             }
@@ -220,23 +668,98 @@ static int load_sectors(const char *path) {
     }
 
     if (ferror(f)) { retval = -128; goto done; }
+
+    const usize ns = firstwall.n, nw = portal.n;
+
+    if (ns < 2) { retval = -9; goto done; }
+
+    // sector and wall indices must fit u32
+    if (ns > UINT32_MAX || nw > UINT32_MAX) { retval = -12; goto done; }
+
+    // check references so that broken/generated levels fail here instead of
+    // in the renderer
+    for (usize i = 1; i < ns; i++) {
+        if ((usize) firstwall.arr[i] + nwalls.arr[i] > nw) {
+            retval = -7; goto done;
+        }
+    }
+
+    for (usize i = 0; i < nw; i++) {
+        if (portal.arr[i] >= ns) { retval = -8; goto done; }
+    }
+
+    level->nsectors = ns;
+    level->nwalls = nw;
+    level->sectors.firstwall = firstwall.arr;
+    level->sectors.nwalls = nwalls.arr;
+    level->sectors.zfloor = zfloor.arr;
+    level->sectors.zceil = zceil.arr;
+    level->walls.a = wa.arr;
+    level->walls.b = wb.arr;
+    level->walls.portal = portal.arr;
 done:
+    if (retval) {
+        free(firstwall.arr);
+        free(nwalls.arr);
+        free(zfloor.arr);
+        free(zceil.arr);
+        free(wa.arr);
+        free(wb.arr);
+        free(portal.arr);
+    }
+
     fclose(f);
     return retval;
 }
 
-static void verline(int x, int y0, int y1, u32 color) {
+static void verline(struct view *view, int x, int y0, int y1, u32 color) {
+    for (int y = y0; y <= y1; y++) {
+        view->pixels[y * view->w + x] = color;
+    }
+}
+
+// amount of fog in [0, 256] at depth z
+static inline u32 fog_amount(f32 z) {
+    const f32 start = state.fog * FOG_START;
+    return (u32) (clamp((z - start) / (state.fog - start), 0.0f, 1.0f) * 256);
+}
+
+// floor/ceiling span at height dz relative to the eye, fogged by row depth
+static void verline_plane(
+    struct view *view, int x, int y0, int y1, f32 dz, u32 color) {
+    if (state.fog <= 0.0f) {
+        verline(view, x, y0, y1, color);
+        return;
+    }
+
+    // depth of row y is k / |y - horizon|. rows nearer than the fog start
+    // keep color, rows beyond the view distance are flat fog and only rows in
+    // between are blended per pixel
+    const f32
+        k = fabsf(dz * VFOV * view->h),
+        dy_near = k / (state.fog * FOG_START),
+        dy_far = k / state.fog;
+
     for (int y = y0; y <= y1; y++) {
-        state.pixels[y * SCREEN_WIDTH + x] = color;
+        const f32 dy = fabsf((f32) (y - (view->h / 2)));
+
+        view->pixels[y * view->w + x] =
+            dy >= dy_near ?
+                color
+                : dy <= dy_far ?
+                    FOG_COLOR
+                    : abgr_lerp(color, FOG_COLOR, fog_amount(k / dy));
     }
 }
 
 // point is in sector if it is on the left side of all walls
-static bool point_in_sector(const struct sector *sector, v2 p) {
-    for (usize i = 0; i < sector->nwalls; i++) {
-        const struct wall *wall = &state.walls.arr[sector->firstwall + i];
+static bool point_in_sector(int id, v2 p) {
+    const struct level *l = &state.level;
+    const u32 first = l->sectors.firstwall[id], n = l->sectors.nwalls[id];
 
-        if (point_side(p, v2i_to_v2(wall->a), v2i_to_v2(wall->b)) > 0) {
+    for (u32 i = first; i < first + n; i++) {
+        if (point_side(
+                p, v2i_to_v2(l->walls.a[i]), v2i_to_v2(l->walls.b[i])) > 0) {
             return false;
         }
     }
@@ -244,15 +767,44 @@ static bool point_in_sector(const struct sector *sector, v2 p) {
     return true;
 }
 
-static void render() {
-    for (int i = 0; i < SCREEN_WIDTH; i++) {
-        state.y_hi[i] = SCREEN_HEIGHT - 1;
-        state.y_lo[i] = 0;
+// grow scratch to fit view width and current level
+static void scratch_reserve(struct render_scratch *scratch, int w) {
+    if (scratch->w < w) {
+        scratch->w = w;
+        scratch->y_lo = realloc(scratch->y_lo, w * sizeof(u16));
+        scratch->y_hi = realloc(scratch->y_hi, w * sizeof(u16));
+        ASSERT(scratch->y_lo && scratch->y_hi, "out of memory");
+    }
+
+    if (scratch->nsectors != state.level.nsectors) {
+        scratch->nsectors = state.level.nsectors;
+        scratch->sectdraw =
+            realloc(scratch->sectdraw, scratch->nsectors * sizeof(u32));
+        ASSERT(scratch->sectdraw, "out of memory");
+        memset(scratch->sectdraw, 0, scratch->nsectors * sizeof(u32));
+        scratch->frame = 0;
+    }
+}
+
+// render level from camera into view. level data is only read so any number
+// of threads can render at once, each with its own scratch
+static void render(
+    const struct camera *camera,
+    struct view *view,
+    struct render_scratch *scratch) {
+    const struct level *l = &state.level;
+    const int w = view->w, h = view->h;
+
+    scratch_reserve(scratch, w);
+    u16 *y_lo = scratch->y_lo, *y_hi = scratch->y_hi;
+
+    for (int i = 0; i < w; i++) {
+        y_hi[i] = h - 1;
+        y_lo[i] = 0;
     }
 
-    // track if sector has already been drawn
-    bool sectdraw[SECTOR_MAX];
-    memset(sectdraw, 0, sizeof(sectdraw));
+    // track if sector has already been drawn this frame
+    const u32 frame = ++scratch->frame;
 
     // calculate edges of near/far planes (looking down +Y axis)
     const v2
@@ -263,34 +815,46 @@ static void render() {
         zfl = (v2) { zdl.x * ZFAR, zdl.y * ZFAR },
         zfr = (v2) { zdr.x * ZFAR, zdr.y * ZFAR };
 
-    enum { QUEUE_MAX = 64 };
-    struct queue_entry { int id, x0, x1; };
-
-    struct { struct queue_entry arr[QUEUE_MAX]; usize n; } queue = {
-        {{ state.camera.sector, 0, SCREEN_WIDTH - 1 }},
-        1
+    scratch->queue.n = 0;
+    *dynarr_push(&scratch->queue) = (struct queue_entry) {
+        .id = camera->sector,
+        .x0 = 0,
+        .x1 = w - 1
     };
 
-    while (queue.n != 0) {
+    while (scratch->queue.n != 0) {
         // grab tail of queue
-        struct queue_entry entry = queue.arr[--queue.n];
+        struct queue_entry entry = scratch->queue.arr[--scratch->queue.n];
 
-        if (sectdraw[entry.id]) {
+        if (scratch->sectdraw[entry.id] == frame) {
             continue;
         }
 
-        sectdraw[entry.id] = true;
+        scratch->sectdraw[entry.id] = frame;
 
-        const struct sector *sector = &state.sectors.arr[entry.id];
+        const u32
+            firstwall = l->sectors.firstwall[entry.id],
+            nwalls = l->sectors.nwalls[entry.id];
 
-        for (usize i = 0; i < sector->nwalls; i++) {
-            const struct wall *wall =
-                &state.walls.arr[sector->firstwall + i];
+        // camera space position of the previous wall's end point, walls of
+        // a sector usually form a loop so it is the next wall's start point
+        v2s prev = { 0, 0 };
+        v2 prevcam = { NAN, NAN };
+
+        for (u32 i = firstwall; i < firstwall + nwalls; i++) {
+            const u32 portal = l->walls.portal[i];
+            const v2s a = l->walls.a[i], b = l->walls.b[i];
 
             // translate relative to player and rotate points around player's view
             const v2
-                op0 = world_pos_to_camera(v2i_to_v2(wall->a)),
-                op1 = world_pos_to_camera(v2i_to_v2(wall->b));
+                op0 =
+                    !isnan(prevcam.x) && a.x == prev.x && a.y == prev.y ?
+                        prevcam
+                        : world_pos_to_camera(camera, v2i_to_v2(a)),
+                op1 = world_pos_to_camera(camera, v2i_to_v2(b));
+
+            prev = b;
+            prevcam = op1;
 
             // wall clipped pos
             v2 cp0 = op0, cp1 = op1;
@@ -338,43 +902,51 @@ static void render() {
 
             // "true" xs before portal clamping
             const int
-                tx0 = screen_angle_to_x(ap0),
-                tx1 = screen_angle_to_x(ap1);
+                tx0 = screen_angle_to_x(ap0, w),
+                tx1 = screen_angle_to_x(ap1, w);
 
             // bounds check against portal window
             if (tx0 > entry.x1) { continue; }
             if (tx1 < entry.x0) { continue; }
 
-            const int wallshade =
-                16 * (sin(atan2f(
-                    wall->b.x - wall->a.x,
-                    wall->b.y - wall->b.y)) + 1.0f);
+            const int wallshade = l->wallshade[i];
+
+            // walls entirely beyond the view distance are flat fog and
+            // portals through them are not traversed, walls entirely before
+            // the fog start are not blended
+            const bool
+                fogged = state.fog > 0.0f && min(cp0.y, cp1.y) >= state.fog,
+                fogblend =
+                    !fogged
+                    && state.fog > 0.0f
+                    && max(cp0.y, cp1.y) > state.fog * FOG_START;
+
+            // inverse depth is linear in screen space
+            const f32 iz0 = 1.0f / cp0.y, iz1 = 1.0f / cp1.y;
 
             const int
                 x0 = clamp(tx0, entry.x0, entry.x1),
                 x1 = clamp(tx1, entry.x0, entry.x1);
 
             const f32
-                z_floor = sector->zfloor,
-                z_ceil = sector->zceil,
-                nz_floor =
-                    wall->portal ? state.sectors.arr[wall->portal].zfloor : 0,
-                nz_ceil =
-                    wall->portal ? state.sectors.arr[wall->portal].zceil : 0;
+                z_floor = l->sectors.zfloor[entry.id],
+                z_ceil = l->sectors.zceil[entry.id],
+                nz_floor = portal ? l->sectors.zfloor[portal] : 0,
+                nz_ceil = portal ? l->sectors.zceil[portal] : 0;
 
             const f32
-                sy0 = ifnan((VFOV * SCREEN_HEIGHT) / cp0.y, 1e10),
-                sy1 = ifnan((VFOV * SCREEN_HEIGHT) / cp1.y, 1e10);
+                sy0 = ifnan((VFOV * h) / cp0.y, 1e10),
+                sy1 = ifnan((VFOV * h) / cp1.y, 1e10);
 
             const int
-                yf0  = (SCREEN_HEIGHT / 2) + (int) (( z_floor - EYE_Z) * sy0),
-                yc0  = (SCREEN_HEIGHT / 2) + (int) (( z_ceil  - EYE_Z) * sy0),
-                yf1  = (SCREEN_HEIGHT / 2) + (int) (( z_floor - EYE_Z) * sy1),
-                yc1  = (SCREEN_HEIGHT / 2) + (int) (( z_ceil  - EYE_Z) * sy1),
-                nyf0 = (SCREEN_HEIGHT / 2) + (int) ((nz_floor - EYE_Z) * sy0),
-                nyc0 = (SCREEN_HEIGHT / 2) + (int) ((nz_ceil  - EYE_Z) * sy0),
-                nyf1 = (SCREEN_HEIGHT / 2) + (int) ((nz_floor - EYE_Z) * sy1),
-                nyc1 = (SCREEN_HEIGHT / 2) + (int) ((nz_ceil  - EYE_Z) * sy1),
+                yf0  = (h / 2) + (int) (( z_floor - EYE_Z) * sy0),
+                yc0  = (h / 2) + (int) (( z_ceil  - EYE_Z) * sy0),
+                yf1  = (h / 2) + (int) (( z_floor - EYE_Z) * sy1),
+                yc1  = (h / 2) + (int) (( z_ceil  - EYE_Z) * sy1),
+                nyf0 = (h / 2) + (int) ((nz_floor - EYE_Z) * sy0),
+                nyc0 = (h / 2) + (int) ((nz_ceil  - EYE_Z) * sy0),
+                nyf1 = (h / 2) + (int) ((nz_floor - EYE_Z) * sy1),
+                nyc1 = (h / 2) + (int) ((nz_ceil  - EYE_Z) * sy1),
                 txd = tx1 - tx0,
                 yfd = yf1 - yf0,
                 ycd = yc1 - yc0,
@@ -389,77 +961,95 @@ static void render() {
                 // proper heights
                 const f32 xp = ifnan((x - tx0) / (f32) txd, 0);
 
+                const u32 fog =
+                    fogged ?
+                        256
+                        : fogblend ?
+                            fog_amount(1.0f / (iz0 + (xp * (iz1 - iz0))))
+                        : 0;
+
                 // get y coordinates for this x
                 const int
                     tyf = (int) (xp * yfd) + yf0,
                     tyc = (int) (xp * ycd) + yc0,
-                    yf = clamp(tyf, state.y_lo[x], state.y_hi[x]),
-                    yc = clamp(tyc, state.y_lo[x], state.y_hi[x]);
+                    yf = clamp(tyf, y_lo[x], y_hi[x]),
+                    yc = clamp(tyc, y_lo[x], y_hi[x]);
 
                 // floor
-                if (yf > state.y_lo[x]) {
-                    verline(
+                if (yf > y_lo[x]) {
+                    verline_plane(
+                        view,
                         x,
-                        state.y_lo[x],
+                        y_lo[x],
                         yf,
+                        z_floor - EYE_Z,
                         0xFFFF0000);
                 }
 
                 // ceiling
-                if (yc < state.y_hi[x]) {
-                    verline(
+                if (yc < y_hi[x]) {
+                    verline_plane(
+                        view,
                         x,
                         yc,
-                        state.y_hi[x],
+                        y_hi[x],
+                        z_ceil - EYE_Z,
                         0xFF00FFFF);
                 }
 
-                if (wall->portal) {
+                if (portal && !fogged) {
                     const int
                         tnyf = (int) (xp * nyfd) + nyf0,
                         tnyc = (int) (xp * nycd) + nyc0,
-                        nyf = clamp(tnyf, state.y_lo[x], state.y_hi[x]),
-                        nyc = clamp(tnyc, state.y_lo[x], state.y_hi[x]);
+                        nyf = clamp(tnyf, y_lo[x], y_hi[x]),
+                        nyc = clamp(tnyc, y_lo[x], y_hi[x]);
 
                     verline(
+                        view,
                         x,
                         nyc,
                         yc,
-                        abgr_mul(0xFF00FF00, shade));
+                        abgr_lerp(
+                            abgr_mul(0xFF00FF00, shade), FOG_COLOR, fog));
 
                     verline(
+                        view,
                         x,
                         yf,
                         nyf,
-                        abgr_mul(0xFF0000FF, shade));
+                        abgr_lerp(
+                            abgr_mul(0xFF0000FF, shade), FOG_COLOR, fog));
 
-                    state.y_hi[x] =
+                    y_hi[x] =
                         clamp(
-                            min(min(yc, nyc), state.y_hi[x]),
-                            0, SCREEN_HEIGHT - 1);
+                            min(min(yc, nyc), y_hi[x]),
+                            0, h - 1);
 
-                    state.y_lo[x] =
+                    y_lo[x] =
                         clamp(
-                            max(max(yf, nyf), state.y_lo[x]),
-                            0, SCREEN_HEIGHT - 1);
+                            max(max(yf, nyf), y_lo[x]),
+                            0, h - 1);
                 } else {
                     verline(
+                        view,
                         x,
                         yf,
                         yc,
-                        abgr_mul(0xFFD0D0D0, shade));
+                        fogged ?
+                            FOG_COLOR
+                            : abgr_lerp(
+                                abgr_mul(0xFFD0D0D0, shade), FOG_COLOR, fog));
                 }
 
-                if (state.sleepy) {
+                if (state.sleepy && view == &state.view) {
                     present();
                     SDL_Delay(10);
                 }
             }
 
-            if (wall->portal) {
-                ASSERT(queue.n != QUEUE_MAX, "out of queue space");
-                queue.arr[queue.n++] = (struct queue_entry) {
-                    .id = wall->portal,
+            if (portal && !fogged) {
+                *dynarr_push(&scratch->queue) = (struct queue_entry) {
+                    .id = portal,
                     .x0 = x0,
                     .x1 = x1
                 };
@@ -467,7 +1057,98 @@ static void render() {
         }
     }
 
-    state.sleepy = false;
+    if (view == &state.view) {
+        state.sleepy = false;
+    }
+}
+
+// take jobs of the current batch until there are none left
+static void pool_work(int thread) {
+    usize i;
+    while ((i = atomic_fetch_add(&state.pool.next, 1)) < state.pool.njobs) {
+        state.pool.job(i, thread);
+    }
+}
+
+static void *pool_worker(void *arg) {
+    const int thread = (int) (intptr_t) arg;
+    u64 batch = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&state.pool.mutex);
+        while (state.pool.batch == batch) {
+            pthread_cond_wait(&state.pool.start, &state.pool.mutex);
+        }
+        batch = state.pool.batch;
+        pthread_mutex_unlock(&state.pool.mutex);
+
+        pool_work(thread);
+
+        pthread_mutex_lock(&state.pool.mutex);
+        if (--state.pool.active == 0) {
+            pthread_cond_signal(&state.pool.done);
+        }
+        pthread_mutex_unlock(&state.pool.mutex);
+    }
+
+    return NULL;
+}
+
+// run job(i, thread) for i in [0, n) spread across all cores, returns once
+// all jobs are done. workers are created on first use
+static void pool_run(void (*job)(usize, int), usize n) {
+    if (!state.pool.n) {
+        const long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        state.pool.n = clamp((int) ncpu - 1, 0, POOL_THREADS_MAX);
+
+        pthread_mutex_init(&state.pool.mutex, NULL);
+        pthread_cond_init(&state.pool.start, NULL);
+        pthread_cond_init(&state.pool.done, NULL);
+
+        for (int i = 0; i < state.pool.n; i++) {
+            ASSERT(
+                !pthread_create(
+                    &state.pool.threads[i],
+                    NULL,
+                    pool_worker,
+                    (void*) (intptr_t) (i + 1)),
+                "failed to create worker thread\n");
+        }
+    }
+
+    pthread_mutex_lock(&state.pool.mutex);
+    state.pool.job = job;
+    state.pool.njobs = n;
+    atomic_store(&state.pool.next, 0);
+    state.pool.active = state.pool.n;
+    state.pool.batch++;
+    pthread_cond_broadcast(&state.pool.start);
+    pthread_mutex_unlock(&state.pool.mutex);
+
+    pool_work(0);
+
+    pthread_mutex_lock(&state.pool.mutex);
+    while (state.pool.active != 0) {
+        pthread_cond_wait(&state.pool.done, &state.pool.mutex);
+    }
+    pthread_mutex_unlock(&state.pool.mutex);
+}
+
+static void render_job(usize i, int thread) {
+    render(
+        &state.pool.cameras[i],
+        &state.pool.views[i],
+        thread ? &state.pool.scratch[thread - 1] : &state.scratch);
+}
+
+// render n views (cameras[i] -> views[i]) spread across all cores. the level
+// is shared between all views, views are handed out one at a time so uneven
+// view costs balance out
+static void render_views(
+    const struct camera *cameras, struct view *views, usize n) {
+    state.pool.cameras = cameras;
+    state.pool.views = views;
+    pool_run(render_job, n);
 }
 
 static void present() {
@@ -478,11 +1159,12 @@ static void present() {
         for (usize y = 0; y < SCREEN_HEIGHT; y++) {
             memcpy(
                 &((u8*) px)[y * pitch],
-                &state.pixels[y * SCREEN_WIDTH],
+                &state.view.pixels[y * SCREEN_WIDTH],
                 SCREEN_WIDTH * 4);
         }
     }
     SDL_UnlockTexture(state.texture);
+    state.latency.upload = time_s();
 
     SDL_SetRenderTarget(state.renderer, NULL);
     SDL_SetRenderDrawColor(state.renderer, 0, 0, 0, 0xFF);
@@ -501,167 +1183,2113 @@ static void present() {
     SDL_SetTextureBlendMode(state.debug, SDL_BLENDMODE_BLEND);
     SDL_RenderCopy(state.renderer, state.debug, NULL, &((SDL_Rect) { 0, 0, 512, 512 }));
     SDL_RenderPresent(state.renderer);
+    state.latency.present = time_s();
 }
 
-int main(int argc, char *argv[]) {
-    ASSERT(
-        !SDL_Init(SDL_INIT_VIDEO),
-        "SDL failed to initialize: %s",
-        SDL_GetError());
-
-    state.window =
-        SDL_CreateWindow(
-            "raycast",
-            SDL_WINDOWPOS_CENTERED_DISPLAY(0),
-            SDL_WINDOWPOS_CENTERED_DISPLAY(0),
-            1280,
-            720,
-            0);
-
-    ASSERT(state.window, "failed to create SDL window: %s\n", SDL_GetError());
+// convert frame to output format in state.capture.buf and write it. frames are
+// stored bottom-up so rows are flipped
+static bool capture_write(const u32 *pixels) {
+    const usize npx = SCREEN_WIDTH * SCREEN_HEIGHT;
+    u8 *buf = state.capture.buf;
 
-    state.renderer =
-        SDL_CreateRenderer(
-            state.window,
-            -1,
-            SDL_RENDERER_ACCELERATED
-            | SDL_RENDERER_PRESENTVSYNC);
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        const u32 *row = &pixels[(SCREEN_HEIGHT - 1 - y) * SCREEN_WIDTH];
 
-    state.texture =
-        SDL_CreateTexture(
-            state.renderer,
-            SDL_PIXELFORMAT_ABGR8888,
-            SDL_TEXTUREACCESS_STREAMING,
-            SCREEN_WIDTH,
-            SCREEN_HEIGHT);
-    state.debug =
-        SDL_CreateTexture(
-            state.renderer,
-            SDL_PIXELFORMAT_ABGR8888,
-            SDL_TEXTUREACCESS_TARGET,
-            128,
-            128);
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            const u32 p = row[x];
+            const int
+                r = (p >> 0) & 0xFF,
+                g = (p >> 8) & 0xFF,
+                b = (p >> 16) & 0xFF;
+
+            const usize i = (y * SCREEN_WIDTH) + x;
+
+            if (state.capture.y4m) {
+                // BT.601 limited range, planar 4:4:4
+                buf[i] = (((66 * r) + (129 * g) + (25 * b) + 128) >> 8) + 16;
+                buf[npx + i] =
+                    (((-38 * r) - (74 * g) + (112 * b) + 128) >> 8) + 128;
+                buf[(2 * npx) + i] =
+                    (((112 * r) - (94 * g) - (18 * b) + 128) >> 8) + 128;
+            } else {
+                buf[(i * 3) + 0] = r;
+                buf[(i * 3) + 1] = g;
+                buf[(i * 3) + 2] = b;
+            }
+        }
+    }
 
-    state.pixels = malloc(SCREEN_WIDTH * SCREEN_HEIGHT * 4);
+    if (state.capture.y4m && fputs("FRAME\n", state.capture.file) == EOF) {
+        return false;
+    }
 
-    state.camera.pos = (v2) { 3, 3 };
-    state.camera.angle = 0.0;
-    state.camera.sector = 1;
+    return fwrite(buf, 3, npx, state.capture.file) == npx;
+}
 
-    int ret = 0;
-    ASSERT(
-        !(ret = load_sectors("res/level.txt")),
-        "error while loading sectors: %d",
-        ret);
-    printf(
-        "loaded %zu sectors with %zu walls",
-        state.sectors.n,
-        state.walls.n);
+static void *capture_thread(void *arg) {
+    pthread_mutex_lock(&state.capture.mutex);
 
-    while (!state.quit) {
-        SDL_Event ev;
-        while (SDL_PollEvent(&ev)) {
-            switch (ev.type) {
-                case SDL_QUIT:
-                    state.quit = true;
-                    break;
-                default:
-                    break;
-            }
+    for (;;) {
+        while (state.capture.tail == state.capture.head
+                && !state.capture.stop) {
+            pthread_cond_wait(&state.capture.cond, &state.capture.mutex);
         }
 
-        if (state.quit) {
+        // stop only once everything queued is written
+        if (state.capture.tail == state.capture.head) {
             break;
         }
 
-        const f32 rot_speed = 3.0f * 0.016f, move_speed = 3.0f * 0.016f;
+        const usize slot = state.capture.tail % CAPTURE_RING;
+        const u32 *frame = state.capture.frames[slot];
 
-        const u8 *keystate = SDL_GetKeyboardState(NULL);
+        // drops only add repeats to the newest slot, which is never the one
+        // being written while the ring is full
+        const u32 n = 1 + state.capture.repeat[slot];
+        state.capture.repeat[slot] = 0;
+        pthread_mutex_unlock(&state.capture.mutex);
 
-        if (keystate[SDLK_RIGHT & 0xFFFF]) {
-            state.camera.angle -= rot_speed;
+        for (u32 i = 0; i < n && !state.capture.failed; i++) {
+            if (capture_write(frame)) {
+                state.capture.written++;
+            } else {
+                state.capture.failed = true;
+            }
         }
 
-        if (keystate[SDLK_LEFT & 0xFFFF]) {
-            state.camera.angle += rot_speed;
-        }
+        pthread_mutex_lock(&state.capture.mutex);
+        state.capture.tail++;
+    }
 
-        state.camera.anglecos = cos(state.camera.angle);
-        state.camera.anglesin = sin(state.camera.angle);
+    pthread_mutex_unlock(&state.capture.mutex);
+    return NULL;
+}
 
-        if (keystate[SDLK_UP & 0xFFFF]) {
-            state.camera.pos = (v2) {
-                state.camera.pos.x + (move_speed * state.camera.anglecos),
-                state.camera.pos.y + (move_speed * state.camera.anglesin),
-            };
-        }
+// start capturing to path, format is Y4M if path ends in .y4m and raw RGB24
+// otherwise (ffmpeg -f rawvideo -pixel_format rgb24 -video_size WxH
+// -framerate TICK_RATE)
+static void capture_init(const char *path) {
+    const usize len = strlen(path);
+
+    state.capture.path = path;
+    state.capture.y4m = len >= 4 && !strcmp(path + len - 4, ".y4m");
+    state.capture.file = fopen(path, "wb");
+    ASSERT(state.capture.file, "failed to open %s for capture\n", path);
+
+    if (state.capture.y4m) {
+        fprintf(
+            state.capture.file,
+            "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n",
+            SCREEN_WIDTH,
+            SCREEN_HEIGHT,
+            TICK_RATE);
+    }
 
-        if (keystate[SDLK_DOWN & 0xFFFF]) {
-            state.camera.pos = (v2) {
-                state.camera.pos.x - (move_speed * state.camera.anglecos),
-                state.camera.pos.y - (move_speed * state.camera.anglesin),
-            };
-        }
+    for (int i = 0; i < CAPTURE_RING; i++) {
+        state.capture.frames[i] = malloc(SCREEN_WIDTH * SCREEN_HEIGHT * 4);
+        ASSERT(state.capture.frames[i], "out of memory");
+    }
 
-        if (keystate[SDLK_F1 & 0xFFFF]) {
-            state.sleepy = true;
-        }
+    state.capture.buf = malloc(SCREEN_WIDTH * SCREEN_HEIGHT * 3);
+    ASSERT(state.capture.buf, "out of memory");
 
-        // update player sector
-        {
-            // BFS neighbors in a circular queue, player is likely to be in one
-            // of the neighboring sectors
-            enum { QUEUE_MAX = 64 };
-            int
-                queue[QUEUE_MAX] = { state.camera.sector },
-                i = 0,
-                n = 1,
-                found = SECTOR_NONE;
+    pthread_mutex_init(&state.capture.mutex, NULL);
+    pthread_cond_init(&state.capture.cond, NULL);
+    ASSERT(
+        !pthread_create(&state.capture.thread, NULL, capture_thread, NULL),
+        "failed to create capture thread\n");
+}
 
-            while (n != 0) {
-                // get front of queue and advance to next
-                const int id = queue[i];
-                i = (i + 1) % (QUEUE_MAX);
-                n--;
+// queue frame for the writer thread to be written n times (once per tick it
+// stands for). if the ring is full it is dropped and the newest queued frame
+// is repeated in its place
+static void capture_frame(const u32 *pixels, int n) {
+    if (!state.capture.file || n <= 0) {
+        return;
+    }
 
-                const struct sector *sector = &state.sectors.arr[id];
+    state.capture.submitted += n;
 
-                if (point_in_sector(sector, state.camera.pos)) {
-                    found = id;
-                    break;
-                }
+    pthread_mutex_lock(&state.capture.mutex);
+    const usize
+        head = state.capture.head,
+        queued = head - state.capture.tail;
 
-                // check neighbors
-                for (usize j = 0; j < sector->nwalls; j++) {
-                    const struct wall *wall =
-                        &state.walls.arr[sector->firstwall + j];
+    if (queued == CAPTURE_RING) {
+        state.capture.repeat[(head - 1) % CAPTURE_RING] += n;
+        pthread_mutex_unlock(&state.capture.mutex);
+        state.capture.dropped += n;
+        return;
+    }
+    pthread_mutex_unlock(&state.capture.mutex);
 
-                    if (wall->portal) {
-                        if (n == QUEUE_MAX) {
-                            fprintf(stderr, "out of queue space!");
-                            goto done;
-                        }
+    if (queued > CAPTURE_RING / 2) {
+        state.capture.backlog++;
+    }
 
-                        queue[(i + n) % QUEUE_MAX] = wall->portal;
-                        n++;
-                    }
-                }
-            }
+    state.capture.maxqueued = max(state.capture.maxqueued, queued + 1);
 
+    // slot at head is not touched by the writer until head is advanced
+    memcpy(
+        state.capture.frames[head % CAPTURE_RING],
+        pixels,
+        SCREEN_WIDTH * SCREEN_HEIGHT * 4);
 
-done:
-            if (!found) {
-                fprintf(stderr, "player is not in a sector!");
-                state.camera.sector = 1;
-            } else {
-                state.camera.sector = found;
-            }
-        }
+    pthread_mutex_lock(&state.capture.mutex);
+    state.capture.repeat[head % CAPTURE_RING] = n - 1;
+    state.capture.head++;
+    pthread_cond_signal(&state.capture.cond);
+    pthread_mutex_unlock(&state.capture.mutex);
+}
+
+// flush queued frames, close capture and report stats
+static void capture_finish() {
+    if (!state.capture.file) {
+        return;
+    }
+
+    pthread_mutex_lock(&state.capture.mutex);
+    state.capture.stop = true;
+    pthread_cond_signal(&state.capture.cond);
+    pthread_mutex_unlock(&state.capture.mutex);
+    pthread_join(state.capture.thread, NULL);
 
-        memset(state.pixels, 0, SCREEN_WIDTH * SCREEN_HEIGHT * 4);
-        render();
-        if (!state.sleepy) { present(); }
+    if (fclose(state.capture.file)) {
+        state.capture.failed = true;
     }
+    state.capture.file = NULL;
+
+    printf(
+        "capture %s: frames=%zu written=%zu dropped=%zu backlog=%zu "
+        "max_queued=%zu/%d%s\n",
+        state.capture.path,
+        state.capture.submitted,
+        state.capture.written,
+        state.capture.dropped,
+        state.capture.backlog,
+        state.capture.maxqueued,
+        CAPTURE_RING,
+        state.capture.failed ? " (write failed)" : "");
+
+    for (int i = 0; i < CAPTURE_RING; i++) {
+        free(state.capture.frames[i]);
+    }
+    free(state.capture.buf);
+}
+
+// true if player can go from sector "from" into "to" through a portal: the
+// step up is low enough and the opening is tall enough
+static bool portal_passable(int from, int to) {
+    const struct level *l = &state.level;
+    const f32
+        ff = l->sectors.zfloor[from], fc = l->sectors.zceil[from],
+        tf = l->sectors.zfloor[to], tc = l->sectors.zceil[to];
+
+    return (tf - ff) <= STEP_HEIGHT
+        && (min(fc, tc) - max(ff, tf)) >= PLAYER_HEIGHT;
+}
+
+// true if wall in sector blocks movement
+static bool wall_solid(int sector, u32 wall) {
+    const u32 portal = state.level.walls.portal[wall];
+    return !portal || !portal_passable(sector, portal);
+}
+
+// distance from p to bounding box b, 0 if p is inside
+static f32 bbox_dist(struct bbox b, v2 p) {
+    const v2 d = {
+        max(max(b.min.x - p.x, p.x - b.max.x), 0.0f),
+        max(max(b.min.y - p.y, p.y - b.max.y), 0.0f),
+    };
+    return length(d);
+}
+
+// collect solid walls which the player can touch this tick into
+// state.collide. sectors are visited breadth first through passable portals
+// starting at id, stopping at those whose bounds are further than reach from
+// p so that cost is bounded by the move rather than the level size
+static void collision_walls(int id, v2 p, f32 reach) {
+    const struct level *l = &state.level;
+    state.collide.n = 0;
+    state.collide_sectors.n = 0;
+    *dynarr_push(&state.collide_sectors) = id;
+
+    for (usize i = 0; i < state.collide_sectors.n; i++) {
+        const int sector = state.collide_sectors.arr[i];
+        const u32
+            first = l->sectors.firstwall[sector],
+            nwalls = l->sectors.nwalls[sector];
+
+        for (u32 j = first; j < first + nwalls; j++) {
+            const int portal = l->walls.portal[j];
+
+            // index of portal sector in the visit queue, n if not queued
+            usize k = 0;
+            while (portal
+                   && k < state.collide_sectors.n
+                   && state.collide_sectors.arr[k] != portal) {
+                k++;
+            }
+
+            // walls shared with sectors visited before this one were already
+            // decided from the side closer to id
+            if (portal && k < i) { continue; }
+
+            if (wall_solid(sector, j)) {
+                *dynarr_push(&state.collide) = j;
+            } else if (k == state.collide_sectors.n
+                       && bbox_dist(l->bounds[portal], p) <= reach) {
+                *dynarr_push(&state.collide_sectors) = portal;
+            }
+        }
+    }
+}
+
+// sweep circle at p with radius r along d against segment a-b. returns time
+// of impact in [0, 1] or INFINITY if there is no hit, *n is set to the
+// collision normal
+static f32 sweep_circle_seg(v2 p, v2 d, f32 r, v2 a, v2 b, v2 *n) {
+    f32 t_hit = INFINITY;
+
+    const v2 ab = { b.x - a.x, b.y - a.y };
+    const f32 len2 = dot(ab, ab);
+
+    if (len2 < 0.000001f) { return INFINITY; }
+
+    // segment face, normal facing p
+    const f32 len = sqrtf(len2);
+    v2 wn = { ab.y / len, -ab.x / len };
+    f32 s0 = ((p.x - a.x) * wn.x) + ((p.y - a.y) * wn.y);
+    if (s0 < 0) {
+        wn = (v2) { -wn.x, -wn.y };
+        s0 = -s0;
+    }
+
+    const f32 dn = dot(d, wn);
+    if (dn < 0 && s0 > r - COLLIDE_EPS) {
+        const f32 t = max((s0 - r) / -dn, 0.0f);
+        const v2 c = { p.x + (d.x * t), p.y + (d.y * t) };
+        const f32 u = (((c.x - a.x) * ab.x) + ((c.y - a.y) * ab.y)) / len2;
+
+        if (t <= 1.0f && u >= 0.0f && u <= 1.0f) {
+            t_hit = t;
+            *n = wn;
+        }
+    }
+
+    // segment endpoints
+    const f32 dd = dot(d, d);
+    const v2 vs[2] = { a, b };
+    for (int i = 0; i < 2 && dd > 0.0f; i++) {
+        const v2 m = { p.x - vs[i].x, p.y - vs[i].y };
+        const f32
+            mb = dot(m, d),
+            mc = dot(m, m) - (r * r);
+
+        // moving away or already overlapping (handled by push_out)
+        if (mb >= 0 || mc < 0) { continue; }
+
+        const f32 disc = (mb * mb) - (dd * mc);
+        if (disc < 0) { continue; }
+
+        const f32 t = (-mb - sqrtf(disc)) / dd;
+        if (t >= 0.0f && t <= 1.0f && t < t_hit) {
+            t_hit = t;
+            *n = normalize(((v2) { m.x + (d.x * t), m.y + (d.y * t) }));
+        }
+    }
+
+    return t_hit;
+}
+
+// push circle at p with radius r out of segment a-b
+static v2 push_out(v2 p, f32 r, v2 a, v2 b) {
+    const v2 ab = { b.x - a.x, b.y - a.y };
+    const f32 u =
+        clamp(
+            ifnan(
+                (((p.x - a.x) * ab.x) + ((p.y - a.y) * ab.y)) / dot(ab, ab),
+                0.0f),
+            0.0f, 1.0f);
+    const v2
+        q = { a.x + (ab.x * u), a.y + (ab.y * u) },
+        pq = { p.x - q.x, p.y - q.y };
+    const f32 l = length(pq);
+
+    if (l >= r || l < 0.000001f) { return p; }
+    return (v2) { q.x + ((pq.x / l) * r), q.y + ((pq.y / l) * r) };
+}
+
+static int level_locate(v2 p);
+
+// follow portals crossed by the segment p0 -> p1 starting in sector id,
+// returns the sector which contains p1
+static int track_sector(int id, v2 p0, v2 p1) {
+    // a single tick never crosses more than a handful of portals
+    const struct level *l = &state.level;
+
+    for (int i = 0; i < 8; i++) {
+        if (point_in_sector(id, p1)) {
+            break;
+        }
+
+        const u32 first = l->sectors.firstwall[id], n = l->sectors.nwalls[id];
+
+        int next = SECTOR_NONE;
+        for (u32 j = first; j < first + n; j++) {
+            if (!l->walls.portal[j]) { continue; }
+
+            const v2
+                a = v2i_to_v2(l->walls.a[j]),
+                b = v2i_to_v2(l->walls.b[j]),
+                x = intersect_segs(p0, p1, a, b);
+
+            if (point_side(p1, a, b) > 0 && !isnan(x.x)) {
+                next = l->walls.portal[j];
+                p0 = x;
+                break;
+            }
+        }
+
+        if (!next) { break; }
+        id = next;
+    }
+
+    // no portal crossing found (e.g. pushed across a corner), look it up
+    if (!point_in_sector(id, p1)) {
+        const int found = level_locate(p1);
+        if (found) { id = found; }
+    }
+
+    return id;
+}
+
+// move player along d, sliding along solid walls and updating the player's
+// sector when portals are crossed
+static void move_player(struct camera *p, v2 d) {
+    const struct level *l = &state.level;
+
+    collision_walls(p->sector, p->pos, PLAYER_RADIUS + length(d));
+    const u32 *walls = state.collide.arr;
+    const usize nwalls = state.collide.n;
+
+    v2 pos = p->pos;
+
+    // slide at most a few times, enough for corners
+    for (int i = 0; i < 3 && dot(d, d) > 0.0f; i++) {
+        f32 t = 1.0f;
+        v2 n = { 0.0f, 0.0f };
+
+        for (usize j = 0; j < nwalls; j++) {
+            v2 wn = { 0.0f, 0.0f };
+            const f32 tw =
+                sweep_circle_seg(
+                    pos, d, PLAYER_RADIUS,
+                    v2i_to_v2(l->walls.a[walls[j]]),
+                    v2i_to_v2(l->walls.b[walls[j]]),
+                    &wn);
+
+            if (tw < t) {
+                t = tw;
+                n = wn;
+            }
+        }
+
+        const v2 next = { pos.x + (d.x * t), pos.y + (d.y * t) };
+        p->sector = track_sector(p->sector, pos, next);
+        pos = next;
+
+        if (t >= 1.0f) { break; }
+
+        // remove component of remaining movement into the wall
+        const v2 rem = { d.x * (1.0f - t), d.y * (1.0f - t) };
+        const f32 into = dot(rem, n);
+        d = (v2) { rem.x - (n.x * into), rem.y - (n.y * into) };
+    }
+
+    // resolve any remaining overlap from float error
+    for (usize j = 0; j < nwalls; j++) {
+        const v2 next =
+            push_out(
+                pos, PLAYER_RADIUS,
+                v2i_to_v2(l->walls.a[walls[j]]),
+                v2i_to_v2(l->walls.b[walls[j]]));
+        p->sector = track_sector(p->sector, pos, next);
+        pos = next;
+    }
+
+    p->pos = pos;
+}
+
+// advance player by one simulation tick
+static void tick(const u8 *keystate) {
+    struct camera *p = &state.player.curr;
+    state.player.prev = *p;
+
+    const f32 rot_speed = ROT_SPEED * TICK_DT, move_speed = MOVE_SPEED * TICK_DT;
+
+    if (keystate[SDLK_RIGHT & 0xFFFF]) {
+        p->angle -= rot_speed;
+    }
+
+    if (keystate[SDLK_LEFT & 0xFFFF]) {
+        p->angle += rot_speed;
+    }
+
+    p->anglecos = cos(p->angle);
+    p->anglesin = sin(p->angle);
+
+    v2 d = { 0.0f, 0.0f };
+
+    if (keystate[SDLK_UP & 0xFFFF]) {
+        d = (v2) { move_speed * p->anglecos, move_speed * p->anglesin };
+    }
+
+    if (keystate[SDLK_DOWN & 0xFFFF]) {
+        d = (v2) { -move_speed * p->anglecos, -move_speed * p->anglesin };
+    }
+
+    if (dot(d, d) > 0.0f) {
+        move_player(p, d);
+    }
+}
+
+// interpolate render camera between the last two ticks, alpha in [0, 1]
+static void interpolate_camera(f32 alpha) {
+    const struct camera *p0 = &state.player.prev, *p1 = &state.player.curr;
+
+    state.camera.pos = (v2) {
+        p0->pos.x + ((p1->pos.x - p0->pos.x) * alpha),
+        p0->pos.y + ((p1->pos.y - p0->pos.y) * alpha),
+    };
+    state.camera.angle = p0->angle + ((p1->angle - p0->angle) * alpha);
+    state.camera.anglecos = cos(state.camera.angle);
+    state.camera.anglesin = sin(state.camera.angle);
+
+    // interpolated position can still be behind a portal the player just
+    // crossed
+    state.camera.sector =
+        point_in_sector(p1->sector, state.camera.pos) ?
+            p1->sector : p0->sector;
+}
+
+// average of sector vertices, always inside since sectors are convex
+static v2 sector_center(int id) {
+    const struct level *l = &state.level;
+    const u32 first = l->sectors.firstwall[id], n = l->sectors.nwalls[id];
+
+    v2 c = { 0.0f, 0.0f };
+    for (u32 i = first; i < first + n; i++) {
+        c.x += l->walls.a[i].x;
+        c.y += l->walls.a[i].y;
+    }
+
+    return (v2) { c.x / n, c.y / n };
+}
+
+static void grid_free(struct sector_grid *g) {
+    for (int i = 0; i < g->w * g->h && g->cells; i++) {
+        free(g->cells[i].arr);
+    }
+
+    free(g->cells);
+    *g = (struct sector_grid) { 0 };
+}
+
+// size grid to bounds with roughly 8 sectors per cell
+static void grid_init(struct sector_grid *g, struct bbox bounds, usize nsectors) {
+    const v2 ext = {
+        max(bounds.max.x - bounds.min.x, 1),
+        max(bounds.max.y - bounds.min.y, 1),
+    };
+
+    g->min = v2i_to_v2(bounds.min);
+    g->size = max(sqrtf((ext.x * ext.y * 8.0f) / nsectors), 1.0f);
+    g->w = (int) (ext.x / g->size) + 1;
+    g->h = (int) (ext.y / g->size) + 1;
+    g->nsectors = nsectors;
+    g->cells = calloc((usize) g->w * g->h, sizeof(*g->cells));
+    ASSERT(g->cells, "out of memory");
+}
+
+// true if grid can hold bounds without being resized
+static bool grid_fits(const struct sector_grid *g, struct bbox b, usize nsectors) {
+    return g->cells
+        && nsectors <= g->nsectors * 2
+        && b.min.x >= g->min.x
+        && b.min.y >= g->min.y
+        && b.max.x < g->min.x + (g->w * g->size)
+        && b.max.y < g->min.y + (g->h * g->size);
+}
+
+// range of cells overlapped by box min-max, inclusive
+static void grid_range(
+    const struct sector_grid *g, v2 min, v2 max, v2i *lo, v2i *hi) {
+    *lo = (v2i) {
+        clamp((int) ((min.x - g->min.x) / g->size), 0, g->w - 1),
+        clamp((int) ((min.y - g->min.y) / g->size), 0, g->h - 1),
+    };
+    *hi = (v2i) {
+        clamp((int) ((max.x - g->min.x) / g->size), 0, g->w - 1),
+        clamp((int) ((max.y - g->min.y) / g->size), 0, g->h - 1),
+    };
+}
+
+static void grid_insert(struct sector_grid *g, int id, struct bbox b) {
+    v2i lo, hi;
+    grid_range(g, v2i_to_v2(b.min), v2i_to_v2(b.max), &lo, &hi);
+
+    for (int y = lo.y; y <= hi.y; y++) {
+        for (int x = lo.x; x <= hi.x; x++) {
+            *dynarr_push(&g->cells[(y * g->w) + x]) = id;
+        }
+    }
+}
+
+static void grid_remove(struct sector_grid *g, int id, struct bbox b) {
+    v2i lo, hi;
+    grid_range(g, v2i_to_v2(b.min), v2i_to_v2(b.max), &lo, &hi);
+
+    for (int y = lo.y; y <= hi.y; y++) {
+        for (int x = lo.x; x <= hi.x; x++) {
+            __typeof__(*g->cells) *cell = &g->cells[(y * g->w) + x];
+            for (usize i = 0; i < cell->n; i++) {
+                if (cell->arr[i] == id) {
+                    cell->arr[i] = cell->arr[--cell->n];
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// true if sector i has the same data and walls in both levels
+static bool sector_equal(const struct level *a, const struct level *b, usize i) {
+    const u32
+        fa = a->sectors.firstwall[i],
+        fb = b->sectors.firstwall[i],
+        n = a->sectors.nwalls[i];
+
+    // compare floats bitwise, any edit counts as a change
+    return n == b->sectors.nwalls[i]
+        && !memcmp(&a->sectors.zfloor[i], &b->sectors.zfloor[i], sizeof(f32))
+        && !memcmp(&a->sectors.zceil[i], &b->sectors.zceil[i], sizeof(f32))
+        && !memcmp(&a->walls.a[fa], &b->walls.a[fb], n * sizeof(v2s))
+        && !memcmp(&a->walls.b[fa], &b->walls.b[fb], n * sizeof(v2s))
+        && !memcmp(&a->walls.portal[fa], &b->walls.portal[fb], n * sizeof(u32));
+}
+
+// build derived data (wall shades, sector bounds) for level, the sector grid
+// is built separately by level_grid(). if old is not NULL then data for
+// sectors which did not change is taken from old, old is only read. *changed
+// is set to per-sector flags of sectors which were changed, added or removed
+// (caller frees). returns number of changed sectors
+static usize level_derive(
+    struct level *level, const struct level *old, u8 **changed) {
+    const usize
+        n = level->nsectors,
+        nold = old ? old->nsectors : 0;
+
+    level->wallshade = malloc(level->nwalls * sizeof(*level->wallshade));
+    level->bounds = calloc(n, sizeof(*level->bounds));
+    ASSERT(level->wallshade && level->bounds, "out of memory");
+
+    *changed = calloc(max(n, nold), 1);
+    ASSERT(*changed, "out of memory");
+    usize nchanged = 0;
+
+    for (usize i = 1; i < n; i++) {
+        const u32
+            first = level->sectors.firstwall[i],
+            nwalls = level->sectors.nwalls[i];
+
+        if (i < nold && sector_equal(level, old, i)) {
+            memcpy(
+                &level->wallshade[first],
+                &old->wallshade[old->sectors.firstwall[i]],
+                nwalls * sizeof(*level->wallshade));
+            level->bounds[i] = old->bounds[i];
+            continue;
+        }
+
+        (*changed)[i] = 1;
+        nchanged++;
+
+        struct bbox b = { { INT16_MAX, INT16_MAX }, { INT16_MIN, INT16_MIN } };
+        for (u32 j = first; j < first + nwalls; j++) {
+            const v2s wa = level->walls.a[j], wb = level->walls.b[j];
+
+            level->wallshade[j] =
+                16 * (sin(atan2f(wb.x - wa.x, wb.y - wb.y)) + 1.0f);
+
+            b.min.x = min(b.min.x, wa.x);
+            b.min.y = min(b.min.y, wa.y);
+            b.max.x = max(b.max.x, wa.x);
+            b.max.y = max(b.max.y, wa.y);
+        }
+
+        level->bounds[i] = b;
+    }
+
+    for (usize i = n; i < nold; i++) {
+        (*changed)[i] = 1;
+        nchanged++;
+    }
+
+    return nchanged;
+}
+
+// build sector grid for level from its bounds. if old is not NULL and its
+// grid still fits then it is moved into level and updated in place for only
+// the sectors flagged in changed (see level_derive())
+static void level_grid(
+    struct level *level, struct level *old, const u8 *changed) {
+    const usize
+        n = level->nsectors,
+        nold = old ? old->nsectors : 0;
+
+    struct bbox bounds =
+        { { INT16_MAX, INT16_MAX }, { INT16_MIN, INT16_MIN } };
+    for (usize i = 1; i < n; i++) {
+        bounds.min.x = min(bounds.min.x, level->bounds[i].min.x);
+        bounds.min.y = min(bounds.min.y, level->bounds[i].min.y);
+        bounds.max.x = max(bounds.max.x, level->bounds[i].max.x);
+        bounds.max.y = max(bounds.max.y, level->bounds[i].max.y);
+    }
+
+    if (old && grid_fits(&old->grid, bounds, n)) {
+        level->grid = old->grid;
+        old->grid = (struct sector_grid) { 0 };
+
+        for (usize i = 1; i < max(n, nold); i++) {
+            if (!changed[i]) { continue; }
+            if (i < nold) { grid_remove(&level->grid, i, old->bounds[i]); }
+            if (i < n) { grid_insert(&level->grid, i, level->bounds[i]); }
+        }
+    } else {
+        grid_init(&level->grid, bounds, n);
+        for (usize i = 1; i < n; i++) {
+            grid_insert(&level->grid, i, level->bounds[i]);
+        }
+    }
+}
+
+static void level_free(struct level *level) {
+    free(level->sectors.firstwall);
+    free(level->sectors.nwalls);
+    free(level->sectors.zfloor);
+    free(level->sectors.zceil);
+    free(level->walls.a);
+    free(level->walls.b);
+    free(level->walls.portal);
+    free(level->wallshade);
+    free(level->bounds);
+    grid_free(&level->grid);
+    *level = (struct level) { 0 };
+}
+
+// find sector containing p, SECTOR_NONE if there is none
+static int level_locate(v2 p) {
+    const struct sector_grid *g = &state.level.grid;
+    v2i lo, hi;
+    grid_range(g, p, p, &lo, &hi);
+
+    const __typeof__(*g->cells) *cell = &g->cells[(lo.y * g->w) + lo.x];
+    for (usize i = 0; i < cell->n; i++) {
+        if (point_in_sector(cell->arr[i], p)) {
+            return cell->arr[i];
+        }
+    }
+
+    return SECTOR_NONE;
+}
+
+// make level current, takes ownership
+static void set_level(struct level *level) {
+    level_free(&state.level);
+    state.level = *level;
+    state.level_version++;
+    *level = (struct level) { 0 };
+}
+
+static void *reload_thread(void *arg) {
+    const f64 t0 = time_s();
+
+    struct level *level = &state.reload.level;
+    state.reload.result = load_sectors(level, state.level_path);
+
+    // current level is only read here, main thread does not modify it until
+    // the reload is done. the new level's sector grid is built from the
+    // current one by reload_poll() on the main thread
+    if (!state.reload.result) {
+        state.reload.nchanged =
+            level_derive(level, &state.level, &state.reload.changed);
+    }
+
+    state.reload.time = time_s() - t0;
+    atomic_store(&state.reload.done, true);
+    return NULL;
+}
+
+// watch level file for changes. on linux the containing directory is watched
+// with inotify since editors often replace the file instead of writing it in
+// place, elsewhere the file's mtime is polled
+static void reload_init() {
+#ifdef __linux__
+    const char *slash = strrchr(state.level_path, '/');
+    char dir[1024];
+    // "/" itself for files in the root directory
+    snprintf(
+        dir, sizeof(dir), "%.*s",
+        slash ? max((int) (slash - state.level_path), 1) : 1,
+        slash ? state.level_path : ".");
+    state.reload.name = slash ? slash + 1 : state.level_path;
+
+    state.reload.fd = inotify_init1(IN_NONBLOCK);
+    if (state.reload.fd < 0
+        || inotify_add_watch(
+            state.reload.fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        fprintf(stderr, "could not watch %s, hot reload disabled\n", dir);
+    }
+#else
+    struct stat st;
+    state.reload.mtime = stat(state.level_path, &st) ? 0 : st.st_mtime;
+#endif
+}
+
+// true if level file changed since last call
+static bool reload_changed() {
+#ifdef __linux__
+    if (state.reload.fd < 0) { return false; }
+
+    bool changed = false;
+    char buf[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    isize len;
+    while ((len = read(state.reload.fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len;) {
+            const struct inotify_event *ev = (const struct inotify_event*) p;
+            if (ev->len && !strcmp(ev->name, state.reload.name)) {
+                changed = true;
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+
+    return changed;
+#else
+    if (time_s() - state.reload.last < 0.5) { return false; }
+    state.reload.last = time_s();
+
+    struct stat st;
+    if (stat(state.level_path, &st) || st.st_mtime == state.reload.mtime) {
+        return false;
+    }
+
+    state.reload.mtime = st.st_mtime;
+    return true;
+#endif
+}
+
+// move camera into the new level, its sector may have changed or be gone
+static void relocate(struct camera *c) {
+    if ((usize) c->sector < state.level.nsectors
+        && point_in_sector(c->sector, c->pos)) {
+        return;
+    }
+
+    c->sector = level_locate(c->pos);
+
+    if (!c->sector) {
+        fprintf(stderr, "player is not in a sector after reload\n");
+        c->sector = 1;
+        c->pos = sector_center(1);
+    }
+}
+
+// start reloads when the level file changes, swap in finished reloads
+static void reload_poll() {
+    if (reload_changed()) {
+        state.reload.pending = true;
+    }
+
+    if (state.reload.running && atomic_load(&state.reload.done)) {
+        pthread_join(state.reload.thread, NULL);
+        state.reload.running = false;
+
+        if (state.reload.result) {
+            fprintf(
+                stderr,
+                "error while reloading sectors: %d\n",
+                state.reload.result);
+            level_free(&state.reload.level);
+        } else {
+            level_grid(
+                &state.reload.level, &state.level, state.reload.changed);
+            set_level(&state.reload.level);
+            relocate(&state.player.prev);
+            relocate(&state.player.curr);
+            printf(
+                "reloaded %zu sectors with %zu walls, %zu changed (%.2fms)\n",
+                state.level.nsectors,
+                state.level.nwalls,
+                state.reload.nchanged,
+                state.reload.time * 1000.0);
+        }
+
+        free(state.reload.changed);
+        state.reload.changed = NULL;
+    }
+
+    if (state.reload.pending && !state.reload.running) {
+        state.reload.pending = false;
+        state.reload.running = true;
+        atomic_store(&state.reload.done, false);
+        state.reload.level = (struct level) { 0 };
+        ASSERT(
+            !pthread_create(&state.reload.thread, NULL, reload_thread, NULL),
+            "failed to create reload thread\n");
+    }
+}
+
+static int cmp_f64(const void *a, const void *b) {
+    const f64 x = *(const f64*) a, y = *(const f64*) b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    const u64 x = *(const u64*) a, y = *(const u64*) b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// union-find root with path halving
+static u32 uf_find(u32 *parent, u32 x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+static void nav_heap_push(struct nav_heap *h, f32 key, f32 g, u32 id) {
+    dynarr_push(h);
+
+    usize i = h->n - 1;
+    while (i > 0 && h->arr[(i - 1) / 2].key > key) {
+        h->arr[i] = h->arr[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->arr[i] = (struct nav_heap_entry) { key, g, id };
+}
+
+static struct nav_heap_entry nav_heap_pop(struct nav_heap *h) {
+    const struct nav_heap_entry top = h->arr[0], last = h->arr[--h->n];
+
+    usize i = 0;
+    for (;;) {
+        usize c = (i * 2) + 1;
+        if (c >= h->n) { break; }
+        if (c + 1 < h->n && h->arr[c + 1].key < h->arr[c].key) { c++; }
+        if (h->arr[c].key >= last.key) { break; }
+        h->arr[i] = h->arr[c];
+        i = c;
+    }
+
+    if (h->n) { h->arr[i] = last; }
+    return top;
+}
+
+static struct nav_scratch *nav_scratch(int thread) {
+    struct nav_scratch *sc = &state.nav.scratch[thread];
+    const usize n = state.level.nsectors, k = state.nav.nclusters;
+
+    if (sc->nsectors != n) {
+        sc->nsectors = n;
+        sc->seen = realloc(sc->seen, n * sizeof(u32));
+        sc->parent = realloc(sc->parent, n * sizeof(u32));
+        sc->via = realloc(sc->via, n * sizeof(u32));
+        sc->g = realloc(sc->g, n * sizeof(f32));
+        ASSERT(sc->seen && sc->parent && sc->via && sc->g, "out of memory");
+        memset(sc->seen, 0, n * sizeof(u32));
+        sc->stamp = 0;
+    }
+
+    if (sc->nclusters != k) {
+        sc->nclusters = k;
+        sc->corridor = realloc(sc->corridor, k * sizeof(u32));
+        sc->dist = realloc(sc->dist, k * sizeof(f32));
+        ASSERT(sc->corridor && sc->dist, "out of memory");
+        memset(sc->corridor, 0, k * sizeof(u32));
+        sc->cstamp = 0;
+    }
+
+    return sc;
+}
+
+// passable in both directions, clusters are grown over these only so that
+// every sector of a cluster can reach every other one inside it
+static bool nav_linked(int a, int b) {
+    return portal_passable(a, b) && portal_passable(b, a);
+}
+
+// distances from every cluster to goal over the reverse cluster graph, fills
+// column goal of the next hop table
+static void nav_build_job(usize goal, int thread) {
+    struct nav_scratch *sc = nav_scratch(thread);
+    const usize k = state.nav.nclusters;
+    u16 *next = &state.nav.next[goal * k];
+
+    for (usize c = 0; c < k; c++) {
+        sc->dist[c] = INFINITY;
+        next[c] = NAV_NONE;
+    }
+
+    sc->dist[goal] = 0.0f;
+    next[goal] = goal;
+    sc->heap.n = 0;
+    nav_heap_push(&sc->heap, 0.0f, 0.0f, goal);
+
+    while (sc->heap.n) {
+        const struct nav_heap_entry e = nav_heap_pop(&sc->heap);
+        if (e.g > sc->dist[e.id]) { continue; }
+
+        const u32 *rfirst = state.nav.rfirst;
+        for (u32 i = rfirst[e.id]; i < rfirst[e.id + 1]; i++) {
+            const u32 c = state.nav.rsrc[i];
+            const v2 d = {
+                state.nav.ccenter[c].x - state.nav.ccenter[e.id].x,
+                state.nav.ccenter[c].y - state.nav.ccenter[e.id].y,
+            };
+            const f32 g = e.g + length(d);
+
+            if (g < sc->dist[c]) {
+                sc->dist[c] = g;
+                next[c] = e.id;
+                nav_heap_push(&sc->heap, g, g, c);
+            }
+        }
+    }
+}
+
+// build navigation data for the current level. sectors are grouped into
+// clusters by breadth-first growth over two-way portals, clusters are linked
+// where any passable portal crosses between them and a next hop table over
+// all cluster pairs is built on the pool. queries then only search sectors in
+// the cluster corridor towards the goal
+static void nav_build() {
+    const f64 t0 = time_s();
+    const struct level *l = &state.level;
+    const usize n = l->nsectors;
+
+    free(state.nav.center);
+    free(state.nav.cluster);
+    free(state.nav.ccenter);
+    free(state.nav.rfirst);
+    free(state.nav.rsrc);
+    free(state.nav.next);
+    state.nav.next = NULL;
+
+    state.nav.center = malloc(n * sizeof(v2));
+    state.nav.cluster = malloc(n * sizeof(u32));
+    u32 *queue = malloc(n * sizeof(u32));
+    ASSERT(
+        state.nav.center && state.nav.cluster && queue,
+        "out of memory");
+
+    state.nav.center[0] = (v2) { 0.0f, 0.0f };
+    for (usize i = 1; i < n; i++) {
+        state.nav.center[i] = sector_center(i);
+    }
+
+    const usize size = max((usize) NAV_CLUSTER_MIN, n / NAV_CLUSTER_DIV);
+
+    // SECTOR_NONE gets a cluster of its own which nothing links to
+    memset(state.nav.cluster, 0xFF, n * sizeof(u32));
+    usize k = 0;
+    for (usize s = 0; s < n; s++) {
+        if (state.nav.cluster[s] != UINT32_MAX) { continue; }
+
+        usize head = 0, tail = 0;
+        queue[tail++] = s;
+        state.nav.cluster[s] = k;
+
+        while (head < tail && s != SECTOR_NONE) {
+            const u32 id = queue[head++];
+            const u32
+                first = l->sectors.firstwall[id],
+                last = first + l->sectors.nwalls[id];
+
+            for (u32 i = first; i < last && tail < size; i++) {
+                const u32 t = l->walls.portal[i];
+                if (!t
+                    || state.nav.cluster[t] != UINT32_MAX
+                    || !nav_linked(id, t)) {
+                    continue;
+                }
+
+                state.nav.cluster[t] = k;
+                queue[tail++] = t;
+            }
+        }
+
+        k++;
+    }
+
+    // growth leaves small fragments between full clusters, merge those into
+    // a linked neighbor while the result stays within twice the target size
+    u32 *merge = malloc(k * sizeof(u32)), *count = calloc(k, sizeof(u32));
+    ASSERT(merge && count, "out of memory");
+
+    for (usize c = 0; c < k; c++) {
+        merge[c] = c;
+    }
+
+    for (usize s = 0; s < n; s++) {
+        count[state.nav.cluster[s]]++;
+    }
+
+    for (usize s = 1; s < n; s++) {
+        const u32 c = uf_find(merge, state.nav.cluster[s]);
+        if (count[c] >= size / 2) { continue; }
+
+        const u32
+            first = l->sectors.firstwall[s],
+            last = first + l->sectors.nwalls[s];
+
+        for (u32 i = first; i < last; i++) {
+            const u32 t = l->walls.portal[i];
+            if (!t || !nav_linked(s, t)) { continue; }
+
+            const u32 d = uf_find(merge, state.nav.cluster[t]);
+            if (d != c && count[c] + count[d] <= size * 2) {
+                merge[c] = d;
+                count[d] += count[c];
+                break;
+            }
+        }
+    }
+
+    // renumber merged clusters densely
+    memset(count, 0xFF, k * sizeof(u32));
+    usize nmerged = 0;
+    for (usize s = 0; s < n; s++) {
+        const u32 c = uf_find(merge, state.nav.cluster[s]);
+        if (count[c] == UINT32_MAX) { count[c] = nmerged++; }
+        state.nav.cluster[s] = count[c];
+    }
+
+    free(merge);
+    free(count);
+    free(queue);
+    k = nmerged;
+
+    state.nav.nclusters = k;
+    state.nav.ccenter = calloc(k, sizeof(v2));
+    state.nav.rfirst = calloc(k + 1, sizeof(u32));
+    count = calloc(k, sizeof(u32));
+    ASSERT(
+        state.nav.ccenter && state.nav.rfirst && count,
+        "out of memory");
+
+    for (usize s = 1; s < n; s++) {
+        const u32 c = state.nav.cluster[s];
+        state.nav.ccenter[c].x += state.nav.center[s].x;
+        state.nav.ccenter[c].y += state.nav.center[s].y;
+        count[c]++;
+    }
+
+    for (usize c = 0; c < k; c++) {
+        if (count[c]) {
+            state.nav.ccenter[c].x /= count[c];
+            state.nav.ccenter[c].y /= count[c];
+        }
+    }
+    free(count);
+
+    // cluster edges as (to << 32) | from, sorted and deduplicated
+    struct { u64 *arr; usize n, cap; } edges = { 0 };
+    for (usize s = 1; s < n; s++) {
+        const u32
+            first = l->sectors.firstwall[s],
+            last = first + l->sectors.nwalls[s];
+
+        for (u32 i = first; i < last; i++) {
+            const u32 t = l->walls.portal[i];
+            if (!t
+                || state.nav.cluster[t] == state.nav.cluster[s]
+                || !portal_passable(s, t)) {
+                continue;
+            }
+
+            *dynarr_push(&edges) =
+                ((u64) state.nav.cluster[t] << 32) | state.nav.cluster[s];
+        }
+    }
+
+    qsort(edges.arr, edges.n, sizeof(u64), cmp_u64);
+
+    state.nav.rsrc = malloc(max(edges.n, (usize) 1) * sizeof(u32));
+    ASSERT(state.nav.rsrc, "out of memory");
+
+    usize nedges = 0;
+    for (usize i = 0; i < edges.n; i++) {
+        if (i && edges.arr[i] == edges.arr[i - 1]) { continue; }
+        state.nav.rfirst[(edges.arr[i] >> 32) + 1]++;
+        state.nav.rsrc[nedges++] = edges.arr[i] & 0xFFFFFFFF;
+    }
+    free(edges.arr);
+
+    for (usize c = 0; c < k; c++) {
+        state.nav.rfirst[c + 1] += state.nav.rfirst[c];
+    }
+
+    if (k <= NAV_CLUSTERS_MAX) {
+        state.nav.next = malloc(k * k * sizeof(u16));
+        ASSERT(state.nav.next, "out of memory");
+        pool_run(nav_build_job, k);
+    }
+
+    state.nav.level_version = state.level_version;
+    state.nav.build_time = time_s() - t0;
+}
+
+// position used for sector id in a search, query endpoints are exact
+static inline v2 nav_pos(const struct nav_query *q, u32 id) {
+    return (int) id == q->to ? q->to_pos
+        : (int) id == q->from ? q->from_pos
+        : state.nav.center[id];
+}
+
+static inline v2 nav_midpoint(u32 wall) {
+    const struct level *l = &state.level;
+    return (v2) {
+        (l->walls.a[wall].x + l->walls.b[wall].x) * 0.5f,
+        (l->walls.a[wall].y + l->walls.b[wall].y) * 0.5f,
+    };
+}
+
+// A* over sectors, edges go through portal wall midpoints and only exist where
+// portal_passable() allows. unless full, the search is limited to the cluster
+// corridor from the next hop table. clusters are internally connected so the
+// corridor always contains a path if there is one, but not necessarily the
+// shortest. lookahead queries stop once the path enters the NAV_LOOKAHEADth
+// cluster of the corridor
+static void nav_search(
+    const struct nav_query *q, struct nav_path *path, int thread, bool full) {
+    const struct level *l = &state.level;
+    struct nav_scratch *sc = nav_scratch(thread);
+
+    *path = (struct nav_path) { 0 };
+
+    if (q->from <= SECTOR_NONE || (usize) q->from >= l->nsectors
+        || q->to <= SECTOR_NONE || (usize) q->to >= l->nsectors) {
+        return;
+    }
+
+    const bool corridor = !full && state.nav.next;
+    u32 stop = UINT32_MAX;
+    if (corridor) {
+        const usize k = state.nav.nclusters;
+        const u32 goal = state.nav.cluster[q->to];
+        const u16 *next = &state.nav.next[goal * k];
+
+        u32 c = state.nav.cluster[q->from];
+        if (next[c] == NAV_NONE) { return; }
+
+        if (++sc->cstamp == 0) {
+            memset(sc->corridor, 0, k * sizeof(u32));
+            sc->cstamp = 1;
+        }
+
+        sc->corridor[c] = sc->cstamp;
+        for (int i = 1; c != goal; i++) {
+            c = next[c];
+            sc->corridor[c] = sc->cstamp;
+
+            if (q->lookahead && i == NAV_LOOKAHEAD && c != goal) {
+                stop = c;
+                break;
+            }
+        }
+    }
+
+    if (++sc->stamp == 0) {
+        memset(sc->seen, 0, sc->nsectors * sizeof(u32));
+        sc->stamp = 1;
+    }
+
+    const u32 stamp = sc->stamp;
+    sc->seen[q->from] = stamp;
+    sc->g[q->from] = 0.0f;
+    sc->parent[q->from] = SECTOR_NONE;
+    sc->heap.n = 0;
+    nav_heap_push(&sc->heap, 0.0f, 0.0f, q->from);
+
+    u32 end = SECTOR_NONE;
+    while (sc->heap.n) {
+        const struct nav_heap_entry e = nav_heap_pop(&sc->heap);
+        if (e.g > sc->g[e.id]) { continue; }
+
+        if ((int) e.id == q->to || state.nav.cluster[e.id] == stop) {
+            end = e.id;
+            break;
+        }
+
+        const v2 p = nav_pos(q, e.id);
+        const u32
+            first = l->sectors.firstwall[e.id],
+            last = first + l->sectors.nwalls[e.id];
+
+        for (u32 i = first; i < last; i++) {
+            const u32 t = l->walls.portal[i];
+            if (!t
+                || (corridor
+                    && sc->corridor[state.nav.cluster[t]] != sc->cstamp)
+                || !portal_passable(e.id, t)) {
+                continue;
+            }
+
+            const v2 m = nav_midpoint(i), pt = nav_pos(q, t);
+            const f32 g =
+                e.g
+                    + length(((v2) { m.x - p.x, m.y - p.y }))
+                    + length(((v2) { pt.x - m.x, pt.y - m.y }));
+
+            if (sc->seen[t] == stamp && sc->g[t] <= g) { continue; }
+
+            sc->seen[t] = stamp;
+            sc->g[t] = g;
+            sc->parent[t] = e.id;
+            sc->via[t] = i;
+
+            const v2 h = { q->to_pos.x - pt.x, q->to_pos.y - pt.y };
+            nav_heap_push(&sc->heap, g + length(h), g, t);
+        }
+    }
+
+    if (end == SECTOR_NONE) { return; }
+
+    path->found = true;
+    path->partial = (int) end != q->to;
+    for (u32 s = end; s != SECTOR_NONE; s = sc->parent[s]) {
+        path->nsectors++;
+    }
+
+    // walk back from the end, writing waypoints back to front
+    const u32 npoints = path->nsectors - 1 + !path->partial;
+    path->npoints = min(npoints, q->points ? q->maxpoints : 0);
+
+    u32 j = npoints;
+    v2 p = q->to_pos;
+    if (!path->partial && --j < path->npoints) {
+        q->points[j] = p;
+    }
+
+    for (u32 s = end; (int) s != q->from; s = sc->parent[s]) {
+        const v2 m = nav_midpoint(sc->via[s]);
+        if (--j < path->npoints) { q->points[j] = m; }
+
+        if (s != end || !path->partial) {
+            path->length += length(((v2) { p.x - m.x, p.y - m.y }));
+        }
+        p = m;
+    }
+
+    path->next = p;
+    path->length += length(((v2) { p.x - q->from_pos.x, p.y - q->from_pos.y }));
+}
+
+static void nav_job(usize i, int thread) {
+    const usize end = min((i + 1) * NAV_BATCH, state.nav.nqueries);
+    for (usize j = i * NAV_BATCH; j < end; j++) {
+        nav_search(&state.nav.queries[j], &state.nav.paths[j], thread, false);
+    }
+}
+
+// answer n navigation queries (queries[i] -> paths[i]) spread across all
+// cores. navigation data is rebuilt first if the level changed
+static void nav_paths(
+    const struct nav_query *queries, struct nav_path *paths, usize n) {
+    if (state.nav.level_version != state.level_version) {
+        nav_build();
+    }
+
+    state.nav.queries = queries;
+    state.nav.paths = paths;
+    state.nav.nqueries = n;
+    pool_run(nav_job, (n + NAV_BATCH - 1) / NAV_BATCH);
+}
+
+// poll window events, noting the earliest keyboard event of this frame as the
+// input time. event timestamps are in SDL_GetTicks() milliseconds
+static void poll_events() {
+    const f64 now = time_s();
+    const u32 ticks = SDL_GetTicks();
+    state.reuse.input = false;
+
+    SDL_Event ev;
+    while (SDL_PollEvent(&ev)) {
+        switch (ev.type) {
+            case SDL_QUIT:
+                state.quit = true;
+                break;
+            case SDL_WINDOWEVENT:
+                // window contents may need to be redrawn
+                state.reuse.valid = false;
+                break;
+            case SDL_KEYDOWN:
+            case SDL_KEYUP: {
+                if (ev.key.repeat) { break; }
+                state.reuse.input = true;
+
+                const f64 t = now - ((ticks - ev.key.timestamp) / 1000.0);
+                state.latency.input =
+                    state.latency.input > 0.0 ? min(state.latency.input, t) : t;
+            }; break;
+            default:
+                break;
+        }
+    }
+}
+
+// wait until the frame has to start to be done just before the next vsync,
+// which is estimated from the last present and the slowest recent frame
+static void latency_wait() {
+    if (state.latency.frames < LATENCY_WORK_FRAMES) {
+        return;
+    }
+
+    f64 work = 0.0;
+    for (int i = 0; i < LATENCY_WORK_FRAMES; i++) {
+        work = max(work, state.latency.work[i]);
+    }
+
+    const f64 wait =
+        state.latency.present + state.latency.period
+            - work - LATENCY_MARGIN - time_s();
+
+    if (wait > 0.0) {
+        usleep(wait * 1000000.0);
+    }
+}
+
+// record timings of a presented frame
+static void latency_record() {
+    const f64 stages[LATENCY_COUNT] = {
+        [LATENCY_SIMULATE] = state.latency.simulate - state.latency.sample,
+        [LATENCY_RENDER] = state.latency.render - state.latency.simulate,
+        [LATENCY_UPLOAD] = state.latency.upload - state.latency.render,
+        [LATENCY_PRESENT] = state.latency.present - state.latency.upload,
+        [LATENCY_SAMPLE_TO_PRESENT] =
+            state.latency.present - state.latency.sample,
+        [LATENCY_INPUT_TO_PRESENT] =
+            state.latency.present - state.latency.input,
+    };
+
+    state.latency.work[state.latency.frames++ % LATENCY_WORK_FRAMES] =
+        state.latency.upload - state.latency.sample;
+
+    if (state.latency.report) {
+        for (int i = 0; i < LATENCY_COUNT; i++) {
+            if (i == LATENCY_INPUT_TO_PRESENT && state.latency.input <= 0.0) {
+                continue;
+            }
+
+            __typeof__(state.latency.samples[0]) *r =
+                &state.latency.samples[i];
+            r->arr[r->n++ % LATENCY_SAMPLES] = stages[i];
+        }
+    }
+
+    state.latency.input = 0.0;
+}
+
+static void latency_report() {
+    if (!state.latency.report) {
+        return;
+    }
+
+    printf(
+        "latency (ms)%s%s:\n",
+        state.latency.low ? " low-latency" : "",
+        state.latency.jit ? " jit" : "");
+
+    for (int i = 0; i < LATENCY_COUNT; i++) {
+        f64 *arr = state.latency.samples[i].arr;
+        const usize n = min(state.latency.samples[i].n, LATENCY_SAMPLES);
+
+        if (!n) {
+            printf("  %-16s n=0\n", LATENCY_NAMES[i]);
+            continue;
+        }
+
+        qsort(arr, n, sizeof(f64), cmp_f64);
+
+        f64 total = 0.0;
+        for (usize j = 0; j < n; j++) {
+            total += arr[j];
+        }
+
+        printf(
+            "  %-16s n=%zu avg=%.3f p50=%.3f p90=%.3f p99=%.3f max=%.3f\n",
+            LATENCY_NAMES[i],
+            n,
+            (total / n) * 1000.0,
+            arr[n / 2] * 1000.0,
+            arr[(n * 90) / 100] * 1000.0,
+            arr[(n * 99) / 100] * 1000.0,
+            arr[n - 1] * 1000.0);
+    }
+}
+
+// camera for step i of the bench path
+static struct camera bench_camera(u64 i) {
+    const int id = 1 + (int) ((i * 7919) % (state.level.nsectors - 1));
+    const f32 angle = i * (TAU / 64.0f);
+
+    return (struct camera) {
+        .pos = sector_center(id),
+        .angle = angle,
+        .anglecos = cos(angle),
+        .anglesin = sin(angle),
+        .sector = id,
+    };
+}
+
+// what the window loop does with a frame, see frame_advance()
+enum {
+    FRAME_RENDER,
+    FRAME_WAIT_TICK,
+    FRAME_WAIT_IDLE,
+};
+
+// advance the window loop clock to now (time_s()), simulating elapsed time in
+// fixed ticks with keystate held, and decide what to do with the frame. if
+// the frame would show the same as the last rendered one it is skipped: while
+// keys are held or input arrived (input) the loop waits for the next tick,
+// otherwise it sleeps until an event and that idle time is not simulated
+static int frame_advance(f64 now, const u8 *keystate, bool input, int *ticks) {
+    if (!state.clock.idle) {
+        state.clock.accum += now - state.clock.last;
+    }
+    state.clock.last = now;
+    state.clock.idle = false;
+
+    state.clock.accum =
+        min(state.clock.accum, TICK_MAX_PER_FRAME * (f64) TICK_DT);
+
+    *ticks = 0;
+    while (state.clock.accum >= TICK_DT) {
+        tick(keystate);
+        state.clock.accum -= TICK_DT;
+        (*ticks)++;
+    }
+
+    if (keystate[SDLK_F1 & 0xFFFF]) {
+        state.sleepy = true;
+    }
+
+    // interpolation shows state up to one tick old, low latency mode
+    // renders the latest tick
+    interpolate_camera(
+        state.latency.low ? 1.0f : state.clock.accum / TICK_DT);
+    state.latency.simulate = time_s();
+
+    if (!state.reuse.enabled
+            || !state.reuse.valid
+            || state.sleepy
+            || state.reuse.level_version != state.level_version
+            || memcmp(
+                &state.reuse.camera, &state.camera, sizeof(state.camera))) {
+        return FRAME_RENDER;
+    }
+
+    // only bound keys count, held modifiers (shift, num lock, ...) do not
+    // move the player
+    if (input
+            || keystate[SDLK_UP & 0xFFFF]
+            || keystate[SDLK_DOWN & 0xFFFF]
+            || keystate[SDLK_LEFT & 0xFFFF]
+            || keystate[SDLK_RIGHT & 0xFFFF]) {
+        return FRAME_WAIT_TICK;
+    }
+
+    // input of this frame changed nothing, it has no present to be measured
+    // against
+    state.latency.input = 0.0;
+    state.clock.idle = true;
+    return FRAME_WAIT_IDLE;
+}
+
+// note the current camera/level as shown by the last rendered frame
+static void reuse_store() {
+    state.reuse.valid = true;
+    state.reuse.camera = state.camera;
+    state.reuse.level_version = state.level_version;
+}
+
+// run the window loop pacing on a simulated clock without a window: idle for
+// a second, hold forward for two, idle again. frames must be skipped while
+// idle and the player must still move once forward is held. exits on failure
+static void check_idle() {
+    u8 keystate[SDL_NUM_SCANCODES] = { 0 };
+    const v2 start = state.player.curr.pos;
+    const f64 down = 1.0, up = 3.0, end = 4.0;
+
+    state.reuse.enabled = true;
+    state.clock.last = 0.0;
+
+    int frames = 0, skipped = 0;
+    bool held = false;
+    for (f64 t = 0.0; t < end;) {
+        const bool key = t >= down && t < up, input = key != held;
+        held = key;
+        keystate[SDLK_UP & 0xFFFF] = key;
+
+        int ticks;
+        switch (frame_advance(t, keystate, input, &ticks)) {
+        case FRAME_WAIT_TICK:
+            skipped++;
+            t += (TICK_DT - state.clock.accum) + 0.001;
+            break;
+        case FRAME_WAIT_IDLE:
+            // wakes up early for the next key event
+            skipped++;
+            t =
+                min(t + (IDLE_WAIT_MS / 1000.0),
+                    t < down ? down : (t < up ? up : end));
+            break;
+        default:
+            reuse_store();
+            frames++;
+            t += 1.0 / 60.0;
+            break;
+        }
+    }
+
+    const v2 d = {
+        state.player.curr.pos.x - start.x,
+        state.player.curr.pos.y - start.y,
+    };
+
+    printf(
+        "check_idle: frames=%d skipped=%d moved=%.2f\n",
+        frames, skipped, length(d));
+    ASSERT(skipped > 0, "check_idle: no frames skipped while idle\n");
+    ASSERT(length(d) > 0.5f, "check_idle: player did not move\n");
+}
+
+// run without a window for a number of ticks, rendering one frame per tick
+// (and capturing it if enabled). input is scripted: walk forward constantly
+// and turn for one of every three seconds so that runs are reproducible.
+// frames are paced to the tick rate like a display would unless uncapped
+static void headless(int frames) {
+    u8 keystate[SDL_NUM_SCANCODES] = { 0 };
+    const f64 start = time_s();
+
+    for (int i = 0; i < frames; i++) {
+        if (!state.uncapped) {
+            const f64 wait = start + (i * (f64) TICK_DT) - time_s();
+            if (wait > 0.0) {
+                usleep(wait * 1000000.0);
+            }
+        }
+
+        keystate[SDLK_UP & 0xFFFF] = 1;
+        keystate[SDLK_LEFT & 0xFFFF] = (i % (3 * TICK_RATE)) < TICK_RATE;
+        tick(keystate);
+
+        state.camera = state.player.curr;
+
+        memset(state.view.pixels, 0, SCREEN_WIDTH * SCREEN_HEIGHT * 4);
+        render(&state.camera, &state.view, &state.scratch);
+        capture_frame(state.view.pixels, 1);
+    }
+}
+
+// render a fixed camera path headless and report load time, memory and frame
+// times. the path visits sectors spread across the whole level, spinning the
+// camera as it goes. if nviews != 0 each frame instead renders a batch of
+// nviews low resolution views along the path through render_views()
+static void bench(int frames, int nviews, f64 load_time) {
+    f64 *times = malloc(frames * sizeof(f64));
+    ASSERT(times, "out of memory");
+
+    const usize nsectors = state.level.nsectors - 1;
+
+    struct camera *cameras = NULL;
+    struct view *views = NULL;
+    if (nviews) {
+        cameras = malloc(nviews * sizeof(struct camera));
+        views = malloc(nviews * sizeof(struct view));
+        ASSERT(cameras && views, "out of memory");
+
+        for (int j = 0; j < nviews; j++) {
+            views[j] = (struct view) {
+                .w = BENCH_VIEW_WIDTH,
+                .h = BENCH_VIEW_HEIGHT,
+            };
+            views[j].pixels = malloc(views[j].w * views[j].h * 4);
+            ASSERT(views[j].pixels, "out of memory");
+        }
+    }
+
+    for (int i = 0; i < frames; i++) {
+        if (!nviews) {
+            state.camera = bench_camera(i);
+
+            const f64 t0 = time_s();
+            memset(state.view.pixels, 0, SCREEN_WIDTH * SCREEN_HEIGHT * 4);
+            render(&state.camera, &state.view, &state.scratch);
+            times[i] = time_s() - t0;
+            continue;
+        }
+
+        for (int j = 0; j < nviews; j++) {
+            cameras[j] = bench_camera(((u64) i * nviews) + j);
+        }
+
+        const f64 t0 = time_s();
+        for (int j = 0; j < nviews; j++) {
+            memset(views[j].pixels, 0, views[j].w * views[j].h * 4);
+        }
+        render_views(cameras, views, nviews);
+        times[i] = time_s() - t0;
+    }
+
+    f64 total = 0.0;
+    for (int i = 0; i < frames; i++) {
+        total += times[i];
+    }
+
+    qsort(times, frames, sizeof(f64), cmp_f64);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    const struct level *l = &state.level;
+
+    usize grid_bytes = (usize) l->grid.w * l->grid.h * sizeof(*l->grid.cells);
+    for (int i = 0; i < l->grid.w * l->grid.h; i++) {
+        grid_bytes += l->grid.cells[i].cap * sizeof(*l->grid.cells[i].arr);
+    }
+
+    const usize
+        sector_bytes =
+            sizeof(*l->sectors.firstwall)
+                + sizeof(*l->sectors.nwalls)
+                + sizeof(*l->sectors.zfloor)
+                + sizeof(*l->sectors.zceil)
+                + sizeof(*l->bounds)
+                + sizeof(*state.scratch.sectdraw),
+        wall_bytes =
+            sizeof(*l->walls.a)
+                + sizeof(*l->walls.b)
+                + sizeof(*l->walls.portal)
+                + sizeof(*l->wallshade),
+        level_bytes =
+            (l->nsectors * sector_bytes)
+                + (l->nwalls * wall_bytes)
+                + grid_bytes;
+
+    printf(
+        "sectors=%zu walls=%zu load_ms=%.2f level_bytes=%zu "
+        "bytes_per_sector=%zu bytes_per_wall=%zu rss_kb=%ld "
+        "frames=%d avg_ms=%.4f p50_ms=%.4f p99_ms=%.4f max_ms=%.4f",
+        nsectors,
+        state.level.nwalls,
+        load_time * 1000.0,
+        level_bytes,
+        sector_bytes,
+        wall_bytes,
+        usage.ru_maxrss,
+        frames,
+        (total / frames) * 1000.0,
+        times[frames / 2] * 1000.0,
+        times[(frames * 99) / 100] * 1000.0,
+        times[frames - 1] * 1000.0);
+
+    if (nviews) {
+        printf(
+            " views=%d threads=%d views_per_s=%.0f",
+            nviews,
+            state.pool.n + 1,
+            (nviews * frames) / total);
+
+        for (int j = 0; j < nviews; j++) {
+            free(views[j].pixels);
+        }
+        free(views);
+        free(cameras);
+    }
+
+    printf("\n");
+    free(times);
+}
+
+// time n queries, once in one nav_paths() batch for throughput and once one
+// at a time on this thread for per query latency. times are sorted
+static f64 nav_bench_pass(
+    const struct nav_query *queries, struct nav_path *paths, int n,
+    f64 *times) {
+    const f64 t0 = time_s();
+    nav_paths(queries, paths, n);
+    const f64 batch_time = time_s() - t0;
+
+    for (int i = 0; i < n; i++) {
+        const f64 t = time_s();
+        nav_search(&queries[i], &paths[i], 0, false);
+        times[i] = time_s() - t;
+    }
+
+    qsort(times, n, sizeof(f64), cmp_f64);
+    return batch_time;
+}
+
+// navigation benchmark: n queries between sectors spread across the level,
+// first for complete paths ("path_") and then for the next waypoint only
+// ("next_", lookahead queries). complete paths of a sample are compared
+// against a search of the whole graph to report how much longer corridor
+// limited paths are
+static void nav_bench(int n) {
+    const usize nsectors = state.level.nsectors - 1;
+
+    struct nav_query *queries = malloc(n * sizeof(struct nav_query));
+    struct nav_path *paths = malloc(n * sizeof(struct nav_path));
+    f64 *times = malloc(n * sizeof(f64));
+    ASSERT(queries && paths && times, "out of memory");
+
+    for (int i = 0; i < n; i++) {
+        const int
+            from = 1 + (int) (((u64) i * 7919) % nsectors),
+            to = 1 + (int) ((((u64) i * 104729) + (nsectors / 2)) % nsectors);
+
+        queries[i] = (struct nav_query) {
+            .from = from,
+            .to = to,
+            .from_pos = sector_center(from),
+            .to_pos = sector_center(to),
+        };
+    }
+
+    // builds navigation data
+    nav_paths(queries, paths, 1);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    const usize
+        k = state.nav.nclusters,
+        nav_bytes =
+            (state.level.nsectors * (sizeof(v2) + sizeof(u32)))
+                + (k * (sizeof(v2) + sizeof(u32)))
+                + (state.nav.rfirst[k] * sizeof(u32))
+                + (state.nav.next ? k * k * sizeof(u16) : 0);
+
+    printf(
+        "sectors=%zu clusters=%zu build_ms=%.2f nav_bytes=%zu rss_kb=%ld "
+        "queries=%d threads=%d",
+        nsectors,
+        k,
+        state.nav.build_time * 1000.0,
+        nav_bytes,
+        usage.ru_maxrss,
+        n,
+        state.pool.n + 1);
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < n; i++) {
+            queries[i].lookahead = pass == 1;
+        }
+
+        const f64 batch_time = nav_bench_pass(queries, paths, n, times);
+
+        int found = 0;
+        f64 total = 0.0, sectors = 0.0;
+        for (int i = 0; i < n; i++) {
+            found += paths[i].found;
+            total += times[i];
+            sectors += paths[i].nsectors;
+        }
+
+        printf(
+            " %s_found=%d %s_sectors=%.1f %s_queries_per_s=%.0f "
+            "%s_avg_us=%.2f %s_p50_us=%.2f %s_p99_us=%.2f",
+            pass ? "next" : "path", found,
+            pass ? "next" : "path", sectors / max(found, 1),
+            pass ? "next" : "path", n / batch_time,
+            pass ? "next" : "path", (total / n) * 1000000.0,
+            pass ? "next" : "path", times[n / 2] * 1000000.0,
+            pass ? "next" : "path", times[(n * 99) / 100] * 1000000.0);
+    }
+
+    // path length relative to the shortest path over the whole graph
+    const int nsample = min(n, 256);
+    f64 ratio = 0.0, ratio_max = 0.0, full_time = 0.0;
+    int ncompared = 0;
+    for (int i = 0; i < nsample; i++) {
+        struct nav_path path, full;
+        queries[i].lookahead = false;
+        nav_search(&queries[i], &path, 0, false);
+
+        const f64 t = time_s();
+        nav_search(&queries[i], &full, 0, true);
+        full_time += time_s() - t;
+
+        ASSERT(
+            full.found == path.found,
+            "nav: query %d reachability mismatch\n",
+            i);
+
+        if (!full.found || full.length <= 0.0f) { continue; }
+
+        const f64 r = path.length / full.length;
+        ratio += r;
+        ratio_max = max(ratio_max, r);
+        ncompared++;
+    }
+
+    printf(
+        " full_avg_us=%.2f length_ratio=%.3f length_ratio_max=%.3f\n",
+        (full_time / nsample) * 1000000.0,
+        ratio / max(ncompared, 1),
+        ratio_max);
+
+    free(times);
+    free(paths);
+    free(queries);
+}
+
+int main(int argc, char *argv[]) {
+    state.level_path = "res/level.txt";
+    int bench_frames = 0, bench_views = 0, headless_frames = 0, nav_queries = 0;
+    bool idle_check = false;
+    const char *capture_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--uncapped")) {
+            state.uncapped = true;
+        } else if (!strcmp(argv[i], "--level") && i + 1 < argc) {
+            state.level_path = argv[++i];
+        } else if (!strcmp(argv[i], "--bench") && i + 1 < argc) {
+            bench_frames = atoi(argv[++i]);
+            ASSERT(bench_frames > 0, "invalid bench frame count\n");
+        } else if (!strcmp(argv[i], "--views") && i + 1 < argc) {
+            bench_views = atoi(argv[++i]);
+            ASSERT(bench_views > 0, "invalid bench view count\n");
+        } else if (!strcmp(argv[i], "--nav-bench") && i + 1 < argc) {
+            nav_queries = atoi(argv[++i]);
+            ASSERT(nav_queries > 0, "invalid nav query count\n");
+        } else if (!strcmp(argv[i], "--check-idle")) {
+            idle_check = true;
+        } else if (!strcmp(argv[i], "--latency")) {
+            state.latency.report = true;
+        } else if (!strcmp(argv[i], "--low-latency")) {
+            state.latency.low = true;
+        } else if (!strcmp(argv[i], "--jit")) {
+            state.latency.low = true;
+            state.latency.jit = true;
+        } else if (!strcmp(argv[i], "--fog") && i + 1 < argc) {
+            state.fog = atof(argv[++i]);
+            ASSERT(state.fog > 0.0f, "invalid fog distance\n");
+        } else if (!strcmp(argv[i], "--capture") && i + 1 < argc) {
+            capture_path = argv[++i];
+        } else if (!strcmp(argv[i], "--headless") && i + 1 < argc) {
+            headless_frames = atoi(argv[++i]);
+            ASSERT(headless_frames > 0, "invalid headless frame count\n");
+        } else {
+            fprintf(stderr, "unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    state.view = (struct view) {
+        .pixels = malloc(SCREEN_WIDTH * SCREEN_HEIGHT * 4),
+        .w = SCREEN_WIDTH,
+        .h = SCREEN_HEIGHT,
+    };
+
+    const f64 load_start = time_s();
+    struct level level = { 0 };
+    int ret = 0;
+    ASSERT(
+        !(ret = load_sectors(&level, state.level_path)),
+        "error while loading sectors: %d\n",
+        ret);
+    u8 *changed;
+    level_derive(&level, NULL, &changed);
+    level_grid(&level, NULL, changed);
+    free(changed);
+    set_level(&level);
+    const f64 load_time = time_s() - load_start;
+
+    printf(
+        "loaded %zu sectors with %zu walls\n",
+        state.level.nsectors,
+        state.level.nwalls);
+
+    // benchmark runs headless
+    if (bench_frames || nav_queries) {
+        if (bench_frames) {
+            bench(bench_frames, bench_views, load_time);
+        }
+
+        if (nav_queries) {
+            nav_bench(nav_queries);
+        }
+
+        return 0;
+    }
+
+    state.player.curr = (struct camera) {
+        .pos = sector_center(1),
+        .angle = 0.0,
+        .anglecos = 1.0,
+        .anglesin = 0.0,
+        .sector = 1,
+    };
+    state.player.prev = state.player.curr;
+
+    if (idle_check) {
+        check_idle();
+        return 0;
+    }
+
+    if (capture_path) {
+        capture_init(capture_path);
+    }
+
+    state.reuse.enabled = !state.uncapped && !capture_path;
+
+    if (headless_frames) {
+        headless(headless_frames);
+        capture_finish();
+        return 0;
+    }
+
+    ASSERT(
+        !SDL_Init(SDL_INIT_VIDEO),
+        "SDL failed to initialize: %s",
+        SDL_GetError());
+
+    state.window =
+        SDL_CreateWindow(
+            "raycast",
+            SDL_WINDOWPOS_CENTERED_DISPLAY(0),
+            SDL_WINDOWPOS_CENTERED_DISPLAY(0),
+            1280,
+            720,
+            0);
+
+    ASSERT(state.window, "failed to create SDL window: %s\n", SDL_GetError());
+
+    state.renderer =
+        SDL_CreateRenderer(
+            state.window,
+            -1,
+            SDL_RENDERER_ACCELERATED
+            | (state.uncapped ? 0 : SDL_RENDERER_PRESENTVSYNC));
+
+    state.texture =
+        SDL_CreateTexture(
+            state.renderer,
+            SDL_PIXELFORMAT_ABGR8888,
+            SDL_TEXTUREACCESS_STREAMING,
+            SCREEN_WIDTH,
+            SCREEN_HEIGHT);
+    state.debug =
+        SDL_CreateTexture(
+            state.renderer,
+            SDL_PIXELFORMAT_ABGR8888,
+            SDL_TEXTUREACCESS_TARGET,
+            128,
+            128);
+
+    reload_init();
+
+    state.clock.last = time_s();
+
+    // frame time stats for uncapped mode, reported once per second
+    struct { u64 start; int frames; } stats = { SDL_GetPerformanceCounter(), 0 };
+
+    SDL_DisplayMode mode;
+    state.latency.period =
+        !SDL_GetCurrentDisplayMode(
+            SDL_GetWindowDisplayIndex(state.window), &mode)
+            && mode.refresh_rate > 0 ?
+            1.0 / mode.refresh_rate
+            : 1.0 / 60.0;
+
+    while (!state.quit) {
+        if (state.latency.jit) {
+            latency_wait();
+        }
+
+        // in low latency mode everything that does not depend on input
+        // happens before input is sampled
+        if (state.latency.low) {
+            reload_poll();
+        }
+
+        poll_events();
+        state.latency.sample = time_s();
+
+        if (state.quit) {
+            break;
+        }
+
+        if (!state.latency.low) {
+            reload_poll();
+        }
+
+        const u8 *keystate = SDL_GetKeyboardState(NULL);
+
+        int ticks = 0;
+        switch (frame_advance(time_s(), keystate, state.reuse.input, &ticks)) {
+        case FRAME_WAIT_TICK:
+            SDL_WaitEventTimeout(
+                NULL, (int) ((TICK_DT - state.clock.accum) * 1000) + 1);
+            continue;
+        case FRAME_WAIT_IDLE:
+            SDL_WaitEventTimeout(NULL, IDLE_WAIT_MS);
+            continue;
+        default:
+            break;
+        }
+
+        memset(state.view.pixels, 0, SCREEN_WIDTH * SCREEN_HEIGHT * 4);
+        render(&state.camera, &state.view, &state.scratch);
+        state.latency.render = time_s();
+
+        reuse_store();
+
+        if (!state.sleepy) {
+            present();
+            latency_record();
+        }
+
+        capture_frame(state.view.pixels, ticks);
+
+        stats.frames++;
+        if (state.uncapped) {
+            const f64 dt =
+                (SDL_GetPerformanceCounter() - stats.start)
+                    / (f64) SDL_GetPerformanceFrequency();
+
+            if (dt >= 1.0) {
+                printf(
+                    "%d fps (%.3f ms/frame)\n",
+                    (int) (stats.frames / dt),
+                    (dt * 1000.0) / stats.frames);
+                stats.start = SDL_GetPerformanceCounter();
+                stats.frames = 0;
+            }
+        }
+    }
+
+    capture_finish();
+    latency_report();
 
     SDL_DestroyTexture(state.debug);
     SDL_DestroyTexture(state.texture);
@@ -1,6 +1,10 @@
+#define _DEFAULT_SOURCE
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <ctype.h>
+#include <sys/resource.h>
 #include <SDL.h>
 
 #define ASSERT(_e, ...) if (!(_e)) { fprintf(stderr, __VA_ARGS__); exit(1); }
@@ -18,9 +22,29 @@ typedef int64_t  i64;
 typedef size_t   usize;
 typedef ssize_t  isize;
 
+#define PI 3.14159265359f
+#define TAU (2.0f * PI)
+
 #define SCREEN_WIDTH 384
 #define SCREEN_HEIGHT 216
 
+// simulation runs at a fixed rate independent of the render rate, rendered
+// view is interpolated between the last two ticks
+#define TICK_RATE 60
+#define TICK_DT (1.0f / TICK_RATE)
+
+// max ticks simulated per frame, time beyond this is dropped so simulation
+// cost stays bounded when rendering is slow
+#define TICK_MAX_PER_FRAME 8
+
+#define ROT_SPEED 3.0f
+#define MOVE_SPEED 3.0f
+
+// fog color and distance at which fog starts as a fraction of the view
+// distance (--fog)
+#define FOG_COLOR 0xFF383838
+#define FOG_START 0.25f
+
 typedef struct v2_s { f32 x, y; } v2;
 typedef struct v2i_s { i32 x, y; } v2i;
 
@@ -39,6 +63,44 @@ typedef struct v2i_s { i32 x, y; } v2i;
         (__typeof__(a))(_a < 0 ? -1 : (_a > 0 ? 1 : 0)); \
     })
 
+// push zeroed element onto a dynamic array { T *arr; usize n, cap; },
+// returns pointer to the new element
+#define dynarr_push(_da) ({                                                    \
+        __typeof__(_da) __da = (_da);                                          \
+        if (__da->n == __da->cap) {                                            \
+            __da->cap = __da->cap ? (__da->cap * 2) : 16;                      \
+            __da->arr = realloc(__da->arr, __da->cap * sizeof(*__da->arr));    \
+            ASSERT(__da->arr, "out of memory");                                \
+        }                                                                      \
+        memset(&__da->arr[__da->n], 0, sizeof(*__da->arr));                    \
+        &__da->arr[__da->n++];                                                 \
+    })
+
+// special cell values, 1-4 are plain walls. doors are thin slabs on the
+// center line of their cell which slide open sideways, pushwalls are walls
+// which move away from the player when used
+#define CELL_DOOR 5
+#define CELL_PUSHWALL 6
+
+// door slot of cells without a door, see state.map.door
+#define DOOR_NONE UINT32_MAX
+
+// door open/close speed (fraction per second), max distance from the player
+// at which doors/pushwalls can be used
+#define DOOR_SPEED 2.0f
+#define USE_DIST 1.5f
+
+// pushwalls move one cell every PUSHWALL_STEP seconds up to PUSHWALL_DIST
+// cells
+#define PUSHWALL_STEP 0.25f
+#define PUSHWALL_DIST 2
+
+// max time to wait for events while idle (ms)
+#define IDLE_WAIT_MS 100
+
+// max levels of the occupancy pyramid above the map
+#define PYRAMID_LEVELS_MAX 16
+
 #define MAP_SIZE 8
 static u8 MAPDATA[MAP_SIZE * MAP_SIZE] = {
     1, 1, 1, 1, 1, 1, 1, 1,
@@ -51,6 +113,28 @@ static u8 MAPDATA[MAP_SIZE * MAP_SIZE] = {
     1, 1, 1, 1, 1, 1, 1, 1,
 };
 
+struct player {
+    v2 pos, dir, plane;
+};
+
+struct door {
+    // cell index
+    u32 cell;
+
+    // slab lies on the cell's x (vertical) or y center line. moving doors are
+    // in state.moving
+    bool vertical, opening, moving;
+
+    // open amount in [0, 1], the open part of the slab is at its low end
+    f32 open;
+};
+
+struct pushwall {
+    v2i pos, dir;
+    int moved;
+    f32 time;
+};
+
 struct {
     SDL_Window *window;
     SDL_Texture *texture;
@@ -58,16 +142,338 @@ struct {
     u32 pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
     bool quit;
 
+    // view used for rendering, interpolated from player state
     v2 pos, dir, plane;
+
+    // player state as of the previous and current simulation tick
+    struct { struct player prev, curr; } player;
+
+    // no vsync, render as fast as possible and report frame times
+    bool uncapped;
+
+    // current map, defaults to MAPDATA. door has the index into state.doors
+    // for each door cell, DOOR_NONE elsewhere. version is incremented
+    // whenever cells or doors change
+    struct { u8 *data; u32 *door; int w, h; u64 version; } map;
+
+    // occupancy pyramid over the map. level 0 is the map itself, level k has
+    // one flag per 2^k x 2^k block which is set if any of its cells is non
+    // empty. the DDA skips empty blocks whole, map_set() updates one flag per
+    // level
+    struct {
+        u8 *data[PYRAMID_LEVELS_MAX + 1];
+        int w[PYRAMID_LEVELS_MAX + 1], h[PYRAMID_LEVELS_MAX + 1];
+        int n;
+    } pyramid;
+
+    struct { struct door *arr; usize n, cap; } doors;
+    struct { struct pushwall *arr; usize n, cap; } pushwalls;
+
+    // cells of doors which are opening or closing, only these are advanced
+    // by tick()
+    struct { u32 *arr; usize n, cap; } moving;
+
+    // use key state as of the last tick, used on press only
+    bool use;
+
+    // doors or pushwalls were moving as of the last tick
+    bool animating;
+
+    // frame reuse. a frame is only rendered if the view or map changed since
+    // the last rendered one, otherwise the window keeps showing it and the
+    // main loop sleeps. on pure rotation columns reuse the hits of the last
+    // frame, cell is UINT32_MAX for columns which can not be reused
+    struct {
+        bool enabled, valid;
+        v2 pos, dir, plane;
+
+        // key events arrived since the last frame
+        bool input;
+
+        u64 version;
+        u32 cell[SCREEN_WIDTH];
+        u8 side[SCREEN_WIDTH];
+    } reuse;
+
+    // view distance, rays stop there and walls fade into FOG_COLOR towards
+    // it. 0 if disabled
+    f32 fog;
+
+    // window loop clock, see frame_advance(). time_s() of the last frame and
+    // real time not simulated yet. idle is set while the loop sleeps, idle
+    // time is not simulated
+    struct {
+        f64 last, accum;
+        bool idle;
+    } clock;
 } state;
 
+// load map from file -> state. format is "<width> <height>" followed by one
+// line of digits per row, lines starting with '#' are comments
+static int load_map(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) { return -1; }
+
+    int retval = 0, w = 0, h = 0, y = 0;
+    u8 *data = NULL;
+
+    char *line = NULL;
+    usize cap = 0;
+    while (getline(&line, &cap, f) != -1) {
+        const char *p = line;
+        while (isspace(*p)) {
+            p++;
+        }
+
+        // skip line, empty or comment
+        if (!*p || *p == '#') {
+            continue;
+        } else if (!data) {
+            if (sscanf(p, "%d %d", &w, &h) != 2 || w <= 0 || h <= 0) {
+                retval = -2; goto done;
+            }
+
+            data = malloc((usize) w * h);
+            if (!data) { retval = -3; goto done; }
+        } else {
+            if (y == h) { retval = -4; goto done; }
+
+            for (int x = 0; x < w; x++) {
+                if (!isdigit(p[x])) { retval = -5; goto done; }
+                data[(y * w) + x] = p[x] - '0';
+            }
+            y++;
+        }
+    }
+
+    if (ferror(f)) { retval = -128; goto done; }
+    if (!data || y != h) { retval = -6; goto done; }
+
+    // DDA relies on the map being closed, doors can be passed
+#define BORDER_OK(_v) ((_v) && (_v) != CELL_DOOR)
+    for (int i = 0; i < w; i++) {
+        if (!BORDER_OK(data[i]) || !BORDER_OK(data[((h - 1) * w) + i])) {
+            retval = -7; goto done;
+        }
+    }
+
+    for (int i = 0; i < h; i++) {
+        if (!BORDER_OK(data[i * w]) || !BORDER_OK(data[(i * w) + w - 1])) {
+            retval = -7; goto done;
+        }
+    }
+#undef BORDER_OK
+
+    state.map.data = data;
+    state.map.w = w;
+    state.map.h = h;
+    data = NULL;
+done:
+    free(data);
+    free(line);
+    fclose(f);
+    return retval;
+}
+
+// occupancy of block (x, y) at pyramid level k, blocks outside of the map are
+// empty
+static inline bool pyramid_get(int k, int x, int y) {
+    if (k == 0) {
+        return x < state.map.w && y < state.map.h
+            && state.map.data[(y * state.map.w) + x];
+    }
+
+    return x < state.pyramid.w[k] && y < state.pyramid.h[k]
+        && state.pyramid.data[k][(y * state.pyramid.w[k]) + x];
+}
+
+// recompute block (x, y) at level k >= 1 from its children
+static inline bool pyramid_block(int k, int x, int y) {
+    return pyramid_get(k - 1, (x * 2) + 0, (y * 2) + 0)
+        || pyramid_get(k - 1, (x * 2) + 1, (y * 2) + 0)
+        || pyramid_get(k - 1, (x * 2) + 0, (y * 2) + 1)
+        || pyramid_get(k - 1, (x * 2) + 1, (y * 2) + 1);
+}
+
+// build pyramid for the current map, levels stop at a single block
+static void pyramid_build() {
+    for (int k = 1; k <= state.pyramid.n; k++) {
+        free(state.pyramid.data[k]);
+    }
+
+    int w = state.map.w, h = state.map.h, k = 0;
+    while ((w > 1 || h > 1) && k < PYRAMID_LEVELS_MAX) {
+        k++;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+
+        state.pyramid.w[k] = w;
+        state.pyramid.h[k] = h;
+        state.pyramid.data[k] = malloc((usize) w * h);
+        ASSERT(state.pyramid.data[k], "out of memory");
+
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                state.pyramid.data[k][(y * w) + x] = pyramid_block(k, x, y);
+            }
+        }
+    }
+
+    state.pyramid.n = k;
+}
+
+// door at cell index, NULL if there is none
+static struct door *door_find(u32 cell) {
+    const u32 i = state.map.door[cell];
+    return i != DOOR_NONE ? &state.doors.arr[i] : NULL;
+}
+
+// remove door at cell index from state.moving
+static void door_stop(u32 cell) {
+    for (usize i = 0; i < state.moving.n; i++) {
+        if (state.moving.arr[i] == cell) {
+            state.moving.arr[i] = state.moving.arr[--state.moving.n];
+            return;
+        }
+    }
+}
+
+// closed door for cell index c, which must not be on the map border
+static struct door door_make(u32 c) {
+    // slab is across the passage: vertical if the passage runs along x
+    return (struct door) {
+        .cell = c,
+        .vertical = !state.map.data[c - 1] || !state.map.data[c + 1],
+    };
+}
+
+// set map cell (x, y) to val, updating the pyramid bottom up. stops as soon as
+// a level does not change so cost is at most one block per level. door
+// records are added/removed with their cells, removal swaps the last record
+// into the freed slot
+static void map_set(int x, int y, u8 val) {
+    ASSERT(
+        x > 0 && x < state.map.w - 1 && y > 0 && y < state.map.h - 1,
+        "map_set out of bounds");
+
+    const u32 c = (y * state.map.w) + x;
+    const u8 old = state.map.data[c];
+    state.map.data[c] = val;
+    state.map.version++;
+
+    if (old == CELL_DOOR && val != CELL_DOOR) {
+        const u32 i = state.map.door[c];
+        if (state.doors.arr[i].moving) { door_stop(c); }
+
+        state.doors.arr[i] = state.doors.arr[--state.doors.n];
+        state.map.door[state.doors.arr[i].cell] = i;
+        state.map.door[c] = DOOR_NONE;
+    } else if (old != CELL_DOOR && val == CELL_DOOR) {
+        state.map.door[c] = state.doors.n;
+        *dynarr_push(&state.doors) = door_make(c);
+    }
+
+    for (int k = 1; k <= state.pyramid.n; k++) {
+        x /= 2;
+        y /= 2;
+
+        u8 *b = &state.pyramid.data[k][(y * state.pyramid.w[k]) + x];
+        const u8 v = pyramid_block(k, x, y);
+        if (*b == v) { break; }
+        *b = v;
+    }
+}
+
+// collect doors and build the pyramid once the map is set
+static void map_init() {
+    const usize ncells = (usize) state.map.w * state.map.h;
+    state.map.door = realloc(state.map.door, ncells * sizeof(u32));
+    ASSERT(state.map.door, "out of memory");
+
+    state.doors.n = 0;
+    state.moving.n = 0;
+    for (usize c = 0; c < ncells; c++) {
+        state.map.door[c] = DOOR_NONE;
+        if (state.map.data[c] != CELL_DOOR) { continue; }
+
+        state.map.door[c] = state.doors.n;
+        *dynarr_push(&state.doors) = door_make(c);
+    }
+
+    pyramid_build();
+}
+
+// ray pos + t * dir is inside door cell (x, y) for t in [t0, t1). returns
+// distance to the door slab if it is hit, -1 otherwise
+static f32 door_hit(
+    const struct door *d, int x, int y, v2 pos, v2 dir, f32 t0, f32 t1) {
+    const f32
+        a = d->vertical ? pos.x : pos.y,
+        b = d->vertical ? pos.y : pos.x,
+        da = d->vertical ? dir.x : dir.y,
+        db = d->vertical ? dir.y : dir.x,
+        c = (d->vertical ? x : y) + 0.5f,
+        o = d->vertical ? y : x;
+
+    if (fabsf(da) < 1e-20) { return -1.0f; }
+
+    const f32 t = (c - a) / da;
+    if (t < t0 || t >= t1) { return -1.0f; }
+
+    // position along the slab, open part of the slab lets the ray through
+    const f32 u = b + (t * db) - o;
+    return u < d->open ? -1.0f : t;
+}
+
 static void verline(int x, int y0, int y1, u32 color) {
     for (int y = y0; y <= y1; y++) {
         state.pixels[(y * SCREEN_WIDTH) + x] = color;
     }
 }
 
+// blend from col0 to col1 by t in [0, 256]
+static inline u32 abgr_lerp(u32 col0, u32 col1, u32 t) {
+    const u32
+        br = (((col0 & 0xFF00FF) * (256 - t)) + ((col1 & 0xFF00FF) * t)) >> 8,
+        g  = (((col0 & 0x00FF00) * (256 - t)) + ((col1 & 0x00FF00) * t)) >> 8;
+
+    return 0xFF000000 | (br & 0xFF00FF) | (g & 0x00FF00);
+}
+
+// amount of fog in [0, 256] at distance d
+static inline u32 fog_amount(f32 d) {
+    if (state.fog <= 0.0f) { return 0; }
+
+    const f32 start = state.fog * FOG_START;
+    return (u32) (max(min((d - start) / (state.fog - start), 1.0f), 0.0f) * 256);
+}
+
 static void render() {
+    // floor/ceiling are flat so their fogged color only depends on the row,
+    // row y is at distance SCREEN_HEIGHT / (2 * |y - center|)
+    u32 planes[SCREEN_HEIGHT];
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        const int dy = abs(y - (SCREEN_HEIGHT / 2));
+        planes[y] =
+            abgr_lerp(
+                y < SCREEN_HEIGHT / 2 ? 0xFF202020 : 0xFF505050,
+                FOG_COLOR,
+                dy ? fog_amount(SCREEN_HEIGHT / (2.0f * dy)) : 256);
+    }
+
+    // pure rotation since the last frame: a column takes the hit of the two
+    // old columns around its ray if both hit the same face of the same cell.
+    // nothing can be hidden between them, the cell in front of the face is
+    // empty and the triangle between the rays and the face is narrower than
+    // a cell. columns which passed doors are never reused
+    const bool rotated =
+        state.reuse.valid
+        && state.reuse.version == state.map.version
+        && !memcmp(&state.reuse.pos, &state.pos, sizeof(v2));
+
+    u32 cells[SCREEN_WIDTH];
+    u8 sides[SCREEN_WIDTH];
+
     for (int x = 0; x < SCREEN_WIDTH; x++) {
         // x coordinate in space from [-1, 1]
         const f32 xcam = (2 * (x / (f32) (SCREEN_WIDTH))) - 1;
@@ -96,11 +502,110 @@ static void render() {
         // integer step direction for x/y, calculated from overall diff
         const v2i step = { (int) sign(dir.x), (int) sign(dir.y) };
 
-        // DDA hit
-        struct { int val, side; v2 pos; } hit = { 0, 0, { 0.0f, 0.0f } };
+        // DDA hit, dist is set for door hits
+        struct { int val, side; v2 pos; f32 dist; } hit =
+            { 0, 0, { 0.0f, 0.0f }, -1.0f };
+
+        // ray reached the view distance without hitting anything
+        bool fogged = false, door = false, reused = false;
 
-        while (!hit.val) {
-            if (sidedist.x < sidedist.y) {
+        if (rotated) {
+            // position of ray on the old view plane, old column coordinate
+            const v2 od = state.reuse.dir, op = state.reuse.plane;
+            const f32
+                t = ((od.x * dir.y) - (od.y * dir.x))
+                    / ((dir.x * op.y) - (dir.y * op.x)),
+                ox = (t + 1) * (SCREEN_WIDTH / 2.0f);
+
+            const int x0 = (int) floorf(ox), x1 = x0 + 1;
+
+            if (x0 >= 0 && x1 < SCREEN_WIDTH
+                    && state.reuse.cell[x0] != UINT32_MAX
+                    && state.reuse.cell[x0] == state.reuse.cell[x1]
+                    && state.reuse.side[x0] == state.reuse.side[x1]
+                    && (dir.x * (od.x + (op.x * t)))
+                        + (dir.y * (od.y + (op.y * t))) > 0.0f) {
+                const u32 c = state.reuse.cell[x0];
+                const v2i ic = { c % state.map.w, c / state.map.w };
+                const int side = state.reuse.side[x0];
+
+                // near face of the hit cell
+                const int face =
+                    side == 0 ?
+                        (ic.x > pos.x ? ic.x : ic.x + 1)
+                        : (ic.y > pos.y ? ic.y : ic.y + 1);
+                const f32 dist =
+                    side == 0 ? (face - pos.x) / dir.x : (face - pos.y) / dir.y;
+
+                // old columns are less than a cell apart up to this distance,
+                // beyond it another cell could sit between x0 and x1
+                if (dist < SCREEN_WIDTH / (2.0f * length(op))) {
+                    reused = true;
+                    ipos = ic;
+                    hit.side = side;
+                    hit.val = state.map.data[c];
+                    hit.dist = dist;
+
+                    if (state.fog > 0.0f && hit.dist > state.fog) {
+                        fogged = true;
+                        hit.val = 0;
+                    }
+                }
+            }
+        }
+
+        while (!reused && !hit.val) {
+            // largest empty pyramid block around current cell
+            int k = 0;
+            while (k < state.pyramid.n
+                    && !pyramid_get(
+                        k + 1, ipos.x >> (k + 1), ipos.y >> (k + 1))) {
+                k++;
+            }
+
+            if (k > 0) {
+                // jump to the first cell outside of the block: the ray
+                // leaves through the nearer of its x/y exit boundaries,
+                // n{x,y} boundaries away
+                const int
+                    s = 1 << k,
+                    bx = (ipos.x >> k) << k,
+                    by = (ipos.y >> k) << k,
+                    nx = step.x > 0 ? (bx + s - ipos.x) : (ipos.x - bx + 1),
+                    ny = step.y > 0 ? (by + s - ipos.y) : (ipos.y - by + 1);
+
+                const f32
+                    tx = step.x ? sidedist.x + ((nx - 1) * deltadist.x) : 1e30,
+                    ty = step.y ? sidedist.y + ((ny - 1) * deltadist.y) : 1e30;
+
+                // boundaries of the other axis crossed before exiting
+                int mx = nx, my = ny;
+                if (tx < ty) {
+                    my = tx > sidedist.y ?
+                        (int) min(
+                            ceilf((tx - sidedist.y) / deltadist.y),
+                            ny - 1.0f)
+                        : 0;
+                    hit.side = 0;
+                } else {
+                    mx = ty > sidedist.x ?
+                        (int) min(
+                            ceilf((ty - sidedist.x) / deltadist.x),
+                            nx - 1.0f)
+                        : 0;
+                    hit.side = 1;
+                }
+
+                if (step.x) {
+                    sidedist.x += mx * deltadist.x;
+                    ipos.x += step.x * mx;
+                }
+
+                if (step.y) {
+                    sidedist.y += my * deltadist.y;
+                    ipos.y += step.y * my;
+                }
+            } else if (sidedist.x < sidedist.y) {
                 sidedist.x += deltadist.x;
                 ipos.x += step.x;
                 hit.side = 0;
@@ -110,26 +615,59 @@ static void render() {
                 hit.side = 1;
             }
 
+            // checked against the distance at which the ray enters the new
+            // cell so that a pyramid jump cannot pass the fog distance
+            const f32 entry =
+                hit.side == 0 ?
+                    (sidedist.x - deltadist.x)
+                    : (sidedist.y - deltadist.y);
+            if (state.fog > 0.0f && entry > state.fog) {
+                fogged = true;
+                break;
+            }
+
             ASSERT(
                 ipos.x >= 0
-                && ipos.x < MAP_SIZE
+                && ipos.x < state.map.w
                 && ipos.y >= 0
-                && ipos.y < MAP_SIZE,
+                && ipos.y < state.map.h,
                 "DDA out of bounds");
 
-            hit.val = MAPDATA[ipos.y * MAP_SIZE + ipos.x];
+            hit.val = state.map.data[ipos.y * state.map.w + ipos.x];
+
+            // doors are partly open cells, test against the slab
+            if (hit.val == CELL_DOOR) {
+                const struct door *d =
+                    door_find((ipos.y * state.map.w) + ipos.x);
+
+                const f32
+                    t0 = hit.side == 0 ?
+                        (sidedist.x - deltadist.x)
+                        : (sidedist.y - deltadist.y),
+                    t1 = min(sidedist.x, sidedist.y);
+
+                hit.dist = door_hit(d, ipos.x, ipos.y, pos, dir, t0, t1);
+                door = true;
+                if (hit.dist < 0.0f) {
+                    hit.val = 0;
+                } else {
+                    hit.side = d->vertical ? 0 : 1;
+                }
+            }
         }
 
-        u32 color;
+        u32 color = FOG_COLOR;
         switch (hit.val) {
         case 1: color = 0xFF0000FF; break;
         case 2: color = 0xFF00FF00; break;
         case 3: color = 0xFFFF0000; break;
         case 4: color = 0xFFFF00FF; break;
+        case CELL_DOOR: color = 0xFF00A0E0; break;
+        case CELL_PUSHWALL: color = 0xFF0000FF; break;
         }
 
         // darken colors on y-sides
-        if (hit.side == 1) {
+        if (hit.side == 1 && !fogged) {
             const u32
                 br = ((color & 0xFF00FF) * 0xC0) >> 8,
                 g  = ((color & 0x00FF00) * 0xC0) >> 8;
@@ -139,11 +677,20 @@ static void render() {
 
         hit.pos = (v2) { pos.x + sidedist.x, pos.y + sidedist.y };
 
-        // distance to hit
+        // distance to hit, fogged columns are drawn as a wall of fog at the
+        // view distance
         const f32 dperp =
-            hit.side == 0 ?
-                (sidedist.x - deltadist.x)
-                : (sidedist.y - deltadist.y);
+            fogged ?
+                state.fog
+                : hit.dist >= 0.0f ?
+                    hit.dist
+                : hit.side == 0 ?
+                    (sidedist.x - deltadist.x)
+                    : (sidedist.y - deltadist.y);
+
+        if (!fogged) {
+            color = abgr_lerp(color, FOG_COLOR, fog_amount(dperp));
+        }
 
         // perform perspective division, calculate line height relative to
         // screen center
@@ -152,21 +699,438 @@ static void render() {
             y0 = max((SCREEN_HEIGHT / 2) - (h / 2), 0),
             y1 = min((SCREEN_HEIGHT / 2) + (h / 2), SCREEN_HEIGHT - 1);
 
-        verline(x, 0, y0, 0xFF202020);
-        verline(x, y0, y1, color);
-        verline(x, y1, SCREEN_HEIGHT - 1, 0xFF505050);
+        cells[x] =
+            fogged || door ?
+                UINT32_MAX
+                : (u32) ((ipos.y * state.map.w) + ipos.x);
+        sides[x] = hit.side;
+
+        if (state.fog > 0.0f) {
+            for (int y = 0; y < y0; y++) {
+                state.pixels[(y * SCREEN_WIDTH) + x] = planes[y];
+            }
+
+            verline(x, y0, y1, color);
+
+            for (int y = y1 + 1; y < SCREEN_HEIGHT; y++) {
+                state.pixels[(y * SCREEN_WIDTH) + x] = planes[y];
+            }
+        } else {
+            verline(x, 0, y0, 0xFF202020);
+            verline(x, y0, y1, color);
+            verline(x, y1, SCREEN_HEIGHT - 1, 0xFF505050);
+        }
+    }
+
+    state.reuse.valid = true;
+    state.reuse.pos = state.pos;
+    state.reuse.dir = state.dir;
+    state.reuse.plane = state.plane;
+    state.reuse.version = state.map.version;
+    memcpy(state.reuse.cell, cells, sizeof(cells));
+    memcpy(state.reuse.side, sides, sizeof(sides));
+}
+
+static void rotate(struct player *player, f32 rot) {
+    const v2 d = player->dir, p = player->plane;
+    player->dir.x = d.x * cos(rot) - d.y * sin(rot);
+    player->dir.y = d.x * sin(rot) + d.y * cos(rot);
+    player->plane.x = p.x * cos(rot) - p.y * sin(rot);
+    player->plane.y = p.x * sin(rot) + p.y * cos(rot);
+}
+
+// use door/pushwall in front of the player
+static void use(const struct player *p) {
+    // first non empty cell within reach
+    for (f32 t = 0.25f; t <= USE_DIST; t += 0.25f) {
+        const v2i c = { p->pos.x + (p->dir.x * t), p->pos.y + (p->dir.y * t) };
+        if (c.x <= 0 || c.x >= state.map.w - 1
+                || c.y <= 0 || c.y >= state.map.h - 1) {
+            return;
+        }
+
+        const u32 cell = (c.y * state.map.w) + c.x;
+        switch (state.map.data[cell]) {
+        case 0: continue;
+        case CELL_DOOR: {
+            struct door *d = door_find(cell);
+            d->opening = !d->opening;
+            if (!d->moving) {
+                d->moving = true;
+                *dynarr_push(&state.moving) = cell;
+            }
+        }; return;
+        case CELL_PUSHWALL: {
+            for (usize i = 0; i < state.pushwalls.n; i++) {
+                const v2i q = state.pushwalls.arr[i].pos;
+                if (q.x == c.x && q.y == c.y) { return; }
+            }
+
+            // moves along the dominant axis of the view direction
+            *dynarr_push(&state.pushwalls) = (struct pushwall) {
+                .pos = c,
+                .dir =
+                    fabsf(p->dir.x) > fabsf(p->dir.y) ?
+                        (v2i) { (int) sign(p->dir.x), 0 }
+                        : (v2i) { 0, (int) sign(p->dir.y) },
+            };
+        }; return;
+        default: return;
+        }
+    }
+}
+
+// advance player by one simulation tick
+static void tick(const u8 *keystate) {
+    struct player *p = &state.player.curr;
+    state.player.prev = *p;
+
+    const f32
+        rotspeed = ROT_SPEED * TICK_DT,
+        movespeed = MOVE_SPEED * TICK_DT;
+
+    if (keystate[SDL_SCANCODE_LEFT]) {
+        rotate(p, +rotspeed);
+    }
+
+    if (keystate[SDL_SCANCODE_RIGHT]) {
+        rotate(p, -rotspeed);
+    }
+
+    if (keystate[SDL_SCANCODE_UP]) {
+        p->pos.x += p->dir.x * movespeed;
+        p->pos.y += p->dir.y * movespeed;
+    }
+
+    if (keystate[SDL_SCANCODE_DOWN]) {
+        p->pos.x -= p->dir.x * movespeed;
+        p->pos.y -= p->dir.y * movespeed;
+    }
+
+    if (keystate[SDL_SCANCODE_SPACE] && !state.use) {
+        use(p);
+    }
+    state.use = keystate[SDL_SCANCODE_SPACE];
+
+    state.animating = state.pushwalls.n > 0 || state.moving.n > 0;
+
+    for (usize i = 0; i < state.moving.n;) {
+        struct door *d = door_find(state.moving.arr[i]);
+        d->open =
+            max(min(
+                d->open + (DOOR_SPEED * TICK_DT * (d->opening ? 1 : -1)),
+                1.0f), 0.0f);
+        state.map.version++;
+
+        // fully open/closed, stops moving
+        if (d->opening ? d->open >= 1.0f : d->open <= 0.0f) {
+            d->moving = false;
+            state.moving.arr[i] = state.moving.arr[--state.moving.n];
+        } else {
+            i++;
+        }
+    }
+
+    for (usize i = 0; i < state.pushwalls.n; i++) {
+        struct pushwall *w = &state.pushwalls.arr[i];
+        if ((w->time += TICK_DT) < PUSHWALL_STEP) { continue; }
+        w->time -= PUSHWALL_STEP;
+
+        const v2i next = { w->pos.x + w->dir.x, w->pos.y + w->dir.y };
+        if (w->moved < PUSHWALL_DIST
+                && !state.map.data[(next.y * state.map.w) + next.x]) {
+            map_set(w->pos.x, w->pos.y, 0);
+            map_set(next.x, next.y, CELL_PUSHWALL);
+            w->pos = next;
+            w->moved++;
+        } else {
+            state.pushwalls.arr[i--] = state.pushwalls.arr[--state.pushwalls.n];
+        }
+    }
+}
+
+// interpolate rendered view between the last two ticks, alpha in [0, 1]
+static void interpolate_view(f32 alpha) {
+    const struct player *p0 = &state.player.prev, *p1 = &state.player.curr;
+
+    state.pos = (v2) {
+        p0->pos.x + ((p1->pos.x - p0->pos.x) * alpha),
+        p0->pos.y + ((p1->pos.y - p0->pos.y) * alpha),
+    };
+
+    // rotation per tick is small, lerp + renormalize is close enough to a
+    // proper slerp
+    state.dir = normalize(((v2) {
+        p0->dir.x + ((p1->dir.x - p0->dir.x) * alpha),
+        p0->dir.y + ((p1->dir.y - p0->dir.y) * alpha),
+    }));
+
+    const f32 plen = length(p1->plane);
+    state.plane = normalize(((v2) {
+        p0->plane.x + ((p1->plane.x - p0->plane.x) * alpha),
+        p0->plane.y + ((p1->plane.y - p0->plane.y) * alpha),
+    }));
+    state.plane = (v2) { state.plane.x * plen, state.plane.y * plen };
+}
+
+static int cmp_f64(const void *a, const void *b) {
+    const f64 x = *(const f64*) a, y = *(const f64*) b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static f64 time_s() {
+    return SDL_GetPerformanceCounter() / (f64) SDL_GetPerformanceFrequency();
+}
+
+// what the window loop does with a frame, see frame_advance()
+enum {
+    FRAME_RENDER,
+    FRAME_WAIT_TICK,
+    FRAME_WAIT_IDLE,
+};
+
+// advance the window loop clock to now (time_s()), simulating elapsed time in
+// fixed ticks with keystate held, and decide what to do with the frame. if
+// the frame would show the same as the last rendered one it is skipped: while
+// keys are held, input arrived (input) or doors/pushwalls move the loop waits
+// for the next tick, otherwise it sleeps until an event and that idle time is
+// not simulated
+static int frame_advance(f64 now, const u8 *keystate, bool input) {
+    if (!state.clock.idle) {
+        state.clock.accum += now - state.clock.last;
+    }
+    state.clock.last = now;
+    state.clock.idle = false;
+
+    state.clock.accum =
+        min(state.clock.accum, TICK_MAX_PER_FRAME * (f64) TICK_DT);
+
+    while (state.clock.accum >= TICK_DT) {
+        tick(keystate);
+        state.clock.accum -= TICK_DT;
+    }
+
+    interpolate_view(state.clock.accum / TICK_DT);
+
+    if (!state.reuse.enabled
+            || !state.reuse.valid
+            || state.reuse.version != state.map.version
+            || memcmp(&state.reuse.pos, &state.pos, sizeof(v2))
+            || memcmp(&state.reuse.dir, &state.dir, sizeof(v2))
+            || memcmp(&state.reuse.plane, &state.plane, sizeof(v2))) {
+        return FRAME_RENDER;
+    }
+
+    // only bound keys count, held modifiers (shift, num lock, ...) do not
+    // change the view
+    if (input
+            || state.animating
+            || keystate[SDL_SCANCODE_UP]
+            || keystate[SDL_SCANCODE_DOWN]
+            || keystate[SDL_SCANCODE_LEFT]
+            || keystate[SDL_SCANCODE_RIGHT]
+            || keystate[SDL_SCANCODE_SPACE]) {
+        return FRAME_WAIT_TICK;
+    }
+
+    state.clock.idle = true;
+    return FRAME_WAIT_IDLE;
+}
+
+// run the window loop pacing on a simulated clock without a window: idle for
+// a second, hold forward briefly (there is no collision, the player must stay
+// on the map), idle again. frames must be skipped while idle and the player
+// must still move once forward is held. exits on failure
+static void check_idle() {
+    u8 keystate[SDL_NUM_SCANCODES] = { 0 };
+    const v2 start = state.player.curr.pos;
+    const f64 down = 1.0, up = 1.25, end = 2.0;
+
+    state.reuse.enabled = true;
+    state.clock.last = 0.0;
+
+    int frames = 0, skipped = 0;
+    bool held = false;
+    for (f64 t = 0.0; t < end;) {
+        const bool key = t >= down && t < up, input = key != held;
+        held = key;
+        keystate[SDL_SCANCODE_UP] = key;
+
+        switch (frame_advance(t, keystate, input)) {
+        case FRAME_WAIT_TICK:
+            skipped++;
+            t += (TICK_DT - state.clock.accum) + 0.001;
+            break;
+        case FRAME_WAIT_IDLE:
+            // wakes up early for the next key event
+            skipped++;
+            t =
+                min(t + (IDLE_WAIT_MS / 1000.0),
+                    t < down ? down : (t < up ? up : end));
+            break;
+        default:
+            render();
+            frames++;
+            t += 1.0 / 60.0;
+            break;
+        }
     }
+
+    const v2 d = {
+        state.player.curr.pos.x - start.x,
+        state.player.curr.pos.y - start.y,
+    };
+
+    printf(
+        "check_idle: frames=%d skipped=%d moved=%.2f\n",
+        frames, skipped, length(d));
+    ASSERT(skipped > 0, "check_idle: no frames skipped while idle\n");
+    ASSERT(length(d) > 0.5f, "check_idle: player did not move\n");
 }
 
-static void rotate(f32 rot) {
-    const v2 d = state.dir, p = state.plane;
-    state.dir.x = d.x * cos(rot) - d.y * sin(rot);
-    state.dir.y = d.x * sin(rot) + d.y * cos(rot);
-    state.plane.x = p.x * cos(rot) - p.y * sin(rot);
-    state.plane.y = p.x * sin(rot) + p.y * cos(rot);
+// render a fixed camera path headless and report load time, memory and frame
+// times. the path visits open cells spread across the whole map, spinning the
+// camera as it goes
+static void bench(int frames, f64 load_time) {
+    f64 *times = malloc(frames * sizeof(f64));
+    ASSERT(times, "out of memory");
+
+    const usize ncells = (usize) state.map.w * state.map.h;
+
+    // the open cell search below needs one to stop at
+    ASSERT(memchr(state.map.data, 0, ncells), "map has no open cell\n");
+
+    for (int i = 0; i < frames; i++) {
+        // next open cell after a well-spread starting point
+        usize c = ((u64) i * 7919) % ncells;
+        while (state.map.data[c]) {
+            c = (c + 1) % ncells;
+        }
+
+        state.player.curr = (struct player) {
+            .pos = { (c % state.map.w) + 0.5f, (c / state.map.w) + 0.5f },
+            .dir = { 1.0f, 0.0f },
+            .plane = { 0.0f, 0.66f },
+        };
+        rotate(&state.player.curr, i * (TAU / 64.0f));
+        state.player.prev = state.player.curr;
+        interpolate_view(1.0f);
+
+        const f64 t0 = time_s();
+        memset(state.pixels, 0, sizeof(state.pixels));
+        render();
+        times[i] = time_s() - t0;
+    }
+
+    f64 total = 0.0;
+    for (int i = 0; i < frames; i++) {
+        total += times[i];
+    }
+
+    qsort(times, frames, sizeof(f64), cmp_f64);
+
+    // dynamic cell updates: toggle cells spread over the map between wall and
+    // empty, then restore them
+    const int nsets = 1 << 20;
+    const f64 set_start = time_s();
+    for (int i = 0; i < nsets; i++) {
+        const u64 j = ((u64) (i % (nsets / 2)) * 7919) % ncells;
+        const int x = j % state.map.w, y = j / state.map.w;
+        if (x == 0 || y == 0 || x == state.map.w - 1 || y == state.map.h - 1) {
+            continue;
+        }
+
+        const u8 v = state.map.data[j];
+        if (v > 1) { continue; }
+
+        map_set(x, y, v ^ 1);
+    }
+    const f64 set_time = time_s() - set_start;
+
+    usize pyramid_bytes = 0;
+    for (int k = 1; k <= state.pyramid.n; k++) {
+        pyramid_bytes += (usize) state.pyramid.w[k] * state.pyramid.h[k];
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf(
+        "cells=%zu load_ms=%.2f map_bytes=%zu pyramid_bytes=%zu rss_kb=%ld "
+        "frames=%d avg_ms=%.4f p50_ms=%.4f p99_ms=%.4f max_ms=%.4f "
+        "set_ns=%.1f\n",
+        ncells,
+        load_time * 1000.0,
+        ncells * (sizeof(*state.map.data) + sizeof(*state.map.door)),
+        pyramid_bytes,
+        usage.ru_maxrss,
+        frames,
+        (total / frames) * 1000.0,
+        times[frames / 2] * 1000.0,
+        times[(frames * 99) / 100] * 1000.0,
+        times[frames - 1] * 1000.0,
+        (set_time * 1e9) / nsets);
+
+    free(times);
 }
 
 int main(int argc, char *argv[]) {
+    const char *map = NULL;
+    int bench_frames = 0;
+    bool idle_check = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--uncapped")) {
+            state.uncapped = true;
+        } else if (!strcmp(argv[i], "--map") && i + 1 < argc) {
+            map = argv[++i];
+        } else if (!strcmp(argv[i], "--fog") && i + 1 < argc) {
+            state.fog = atof(argv[++i]);
+            ASSERT(state.fog > 0.0f, "invalid fog distance\n");
+        } else if (!strcmp(argv[i], "--bench") && i + 1 < argc) {
+            bench_frames = atoi(argv[++i]);
+            ASSERT(bench_frames > 0, "invalid bench frame count\n");
+        } else if (!strcmp(argv[i], "--check-idle")) {
+            idle_check = true;
+        } else {
+            fprintf(stderr, "unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    state.map.data = MAPDATA;
+    state.map.w = MAP_SIZE;
+    state.map.h = MAP_SIZE;
+
+    const f64 load_start = time_s();
+    if (map) {
+        int ret = 0;
+        ASSERT(
+            !(ret = load_map(map)),
+            "error while loading map: %d\n",
+            ret);
+    }
+    map_init();
+    const f64 load_time = time_s() - load_start;
+
+    // benchmark runs headless
+    if (bench_frames) {
+        bench(bench_frames, load_time);
+        return 0;
+    }
+
+    state.player.curr = (struct player) {
+        .pos = { 2, 2 },
+        .dir = normalize(((v2) { -1.0f, 0.1f })),
+        .plane = { 0.0f, 0.66f },
+    };
+    state.player.prev = state.player.curr;
+
+    if (idle_check) {
+        check_idle();
+        return 0;
+    }
+
     ASSERT(
         !SDL_Init(SDL_INIT_VIDEO),
         "SDL failed to initialize: %s\n",
@@ -185,7 +1149,10 @@ int main(int argc, char *argv[]) {
         "failed to create SDL window: %s\n", SDL_GetError());
 
     state.renderer =
-        SDL_CreateRenderer(state.window, -1, SDL_RENDERER_PRESENTVSYNC);
+        SDL_CreateRenderer(
+            state.window,
+            -1,
+            state.uncapped ? 0 : SDL_RENDERER_PRESENTVSYNC);
     ASSERT(
         state.renderer,
         "failed to create SDL renderer: %s\n", SDL_GetError());
@@ -201,41 +1168,45 @@ int main(int argc, char *argv[]) {
         state.texture,
         "failed to create SDL texture: %s\n", SDL_GetError());
 
-    state.pos = (v2) { 2, 2 };
-    state.dir = normalize(((v2) { -1.0f, 0.1f }));
-    state.plane = (v2) { 0.0f, 0.66f };
+    state.reuse.enabled = !state.uncapped;
+
+    state.clock.last = time_s();
+
+    // frame time stats for uncapped mode, reported once per second
+    struct { u64 start; int frames; } stats = { SDL_GetPerformanceCounter(), 0 };
 
     while (!state.quit) {
+        state.reuse.input = false;
+
         SDL_Event ev;
         while (SDL_PollEvent(&ev)) {
             switch (ev.type) {
                 case SDL_QUIT:
                     state.quit = true;
                     break;
+                case SDL_WINDOWEVENT:
+                    // window contents may need to be redrawn
+                    state.reuse.valid = false;
+                    break;
+                case SDL_KEYDOWN:
+                case SDL_KEYUP:
+                    state.reuse.input = true;
+                    break;
             }
         }
 
-        const f32
-            rotspeed = 3.0f * 0.016f,
-            movespeed = 3.0f * 0.016f;
-
         const u8 *keystate = SDL_GetKeyboardState(NULL);
-        if (keystate[SDL_SCANCODE_LEFT]) {
-            rotate(+rotspeed);
-        }
 
-        if (keystate[SDL_SCANCODE_RIGHT]) {
-            rotate(-rotspeed);
-        }
-
-        if (keystate[SDL_SCANCODE_UP]) {
-            state.pos.x += state.dir.x * movespeed;
-            state.pos.y += state.dir.y * movespeed;
-        }
-
-        if (keystate[SDL_SCANCODE_DOWN]) {
-            state.pos.x -= state.dir.x * movespeed;
-            state.pos.y -= state.dir.y * movespeed;
+        switch (frame_advance(time_s(), keystate, state.reuse.input)) {
+        case FRAME_WAIT_TICK:
+            SDL_WaitEventTimeout(
+                NULL, (int) ((TICK_DT - state.clock.accum) * 1000) + 1);
+            continue;
+        case FRAME_WAIT_IDLE:
+            SDL_WaitEventTimeout(NULL, IDLE_WAIT_MS);
+            continue;
+        default:
+            break;
         }
 
         memset(state.pixels, 0, sizeof(state.pixels));
@@ -251,6 +1222,22 @@ int main(int argc, char *argv[]) {
             NULL,
             SDL_FLIP_VERTICAL);
         SDL_RenderPresent(state.renderer);
+
+        stats.frames++;
+        if (state.uncapped) {
+            const f64 dt =
+                (SDL_GetPerformanceCounter() - stats.start)
+                    / (f64) SDL_GetPerformanceFrequency();
+
+            if (dt >= 1.0) {
+                printf(
+                    "%d fps (%.3f ms/frame)\n",
+                    (int) (stats.frames / dt),
+                    (dt * 1000.0) / stats.frames);
+                stats.start = SDL_GetPerformanceCounter();
+                stats.frames = 0;
+            }
+        }
     }
 
     SDL_DestroyTexture(state.texture);